@@ -0,0 +1,245 @@
+#include "BitBoard.hpp"
+
+#include <glog/logging.h>
+#include <string.h>
+
+bool BitBoard::Fits(const uint16_t cols, const uint16_t rows) {
+  return cols > 0 && rows > 0 && cols * (rows + 1) <= 64;
+}
+
+uint64_t BitBoard::Mirror(const uint64_t mask, const uint16_t cols,
+                          const uint16_t rows) {
+  const uint32_t h1 = rows + 1;
+  const uint64_t column = (UINT64_C(1) << h1) - 1;
+  uint64_t m = 0;
+  for (uint16_t c = 0; c < cols; ++c) {
+    m |= ((mask >> (c * h1)) & column) << ((cols - 1 - c) * h1);
+  }
+  return m;
+}
+
+BitBoard::BitBoard(const uint16_t cols, const uint16_t rows)
+    : disc_{0, 0}, hash_(0), mirror_hash_(0), cols_(cols), rows_(rows),
+      ids_{' ', ' '} {
+  CHECK(Fits(cols_, rows_)) << "Board " << cols_ << "x" << rows_
+                            << " does not fit in a BitBoard";
+}
+
+BitBoard::BitBoard(const Board& board)
+    : disc_{0, 0}, hash_(0), mirror_hash_(0), cols_(board.Cols()),
+      rows_(board.Rows()), ids_{' ', ' '} {
+  CHECK(Fits(cols_, rows_)) << "Board " << cols_ << "x" << rows_
+                            << " does not fit in a BitBoard";
+  for (uint16_t col = 0; col < cols_; ++col) {
+    for (uint16_t row = 0; row < board.Height(col); ++row) {
+      const int s = Slot(board.Get(col, row));
+      CHECK_GE(s, 0) << "BitBoard only supports two players";
+      disc_[s] |= Bit(col, row);
+      hash_ ^= Zobrist::Cell(col, row, ids_[s]);
+      mirror_hash_ ^= Zobrist::Cell(cols_ - 1 - col, row, ids_[s]);
+    }
+  }
+}
+
+bool BitBoard::operator == (const BitBoard& other) const {
+  if (cols_ != other.cols_ || rows_ != other.rows_) return false;
+  for (uint16_t col = 0; col < cols_; ++col) {
+    for (uint16_t row = 0; row < rows_; ++row) {
+      if (Get(col, row) != other.Get(col, row)) return false;
+    }
+  }
+  return true;
+}
+
+int BitBoard::Slot(const uint8_t p) {
+  if (ids_[0] == p) return 0;
+  if (ids_[1] == p) return 1;
+  if (ids_[0] == ' ') { ids_[0] = p; return 0; }
+  if (ids_[1] == ' ') { ids_[1] = p; return 1; }
+  return -1;
+}
+
+Coord BitBoard::BitCoord(const uint32_t bit) const {
+  return Coord(bit / (rows_ + 1), bit % (rows_ + 1));
+}
+
+bool BitBoard::Move(const uint32_t move_id, const uint8_t p) {
+  if (move_id >= cols_) {
+    LOG(INFO) << "Player " << p << " picked a out-of-board column";
+    return false;
+  }
+  const uint16_t col = move_id;
+  const uint16_t row = Height(col);
+  if (row >= rows_) {
+    LOG(INFO) << "Player " << p << " chose a filled column";
+    return false;
+  }
+  const int s = Slot(p);
+  if (s < 0) {
+    LOG(INFO) << "Player " << p << " is not one of the two board players";
+    return false;
+  }
+  DLOG(INFO) << "Player " << p << " put a disc at column " << col;
+  disc_[s] |= Bit(col, row);
+  hash_ ^= Zobrist::Cell(col, row, p);
+  mirror_hash_ ^= Zobrist::Cell(cols_ - 1 - col, row, p);
+  return true;
+}
+
+bool BitBoard::Undo(const uint32_t move_id) {
+  if (move_id >= cols_ || Height(move_id) == 0) {
+    LOG(INFO) << "Cannot undo a move at column " << move_id;
+    return false;
+  }
+  const uint16_t row = Height(move_id) - 1;
+  const uint64_t top = Bit(move_id, row);
+  const uint8_t p = Get(move_id, row);
+  hash_ ^= Zobrist::Cell(move_id, row, p);
+  mirror_hash_ ^= Zobrist::Cell(cols_ - 1 - move_id, row, p);
+  disc_[0] &= ~top;
+  disc_[1] &= ~top;
+  return true;
+}
+
+Winner BitBoard::CheckWinner() const {
+  return FindWinner(0);
+}
+
+Winner BitBoard::CheckWinnerAt(const uint16_t col) const {
+  if (!WinsAt(col)) return Winner();
+  return FindWinner(Bit(col, Height(col) - 1));
+}
+
+// Only the windows through the given bit are considered, or all of them if
+// it is 0.
+Winner BitBoard::FindWinner(const uint64_t through) const {
+  // Directions in the same order Board::CheckWinner tests them: vertical,
+  // horizontal, right-left diagonal and left-right diagonal. The winner
+  // reported is the one Board would find first when scanning the cells
+  // column by column, so both representations agree on the winning cells.
+  const uint32_t h1 = rows_ + 1;
+  const uint32_t dirs[4] = {1, h1, h1 - 1, h1 + 1};
+  uint32_t best_key = ~0U;
+  uint8_t best_player = Winner::NONE;
+  Coord coords[4];
+  for (int s = 0; s < 2; ++s) {
+    if (disc_[s] == 0) continue;
+    for (int d = 0; d < 4; ++d) {
+      uint64_t f = Fours(disc_[s], dirs[d]);
+      if (through != 0) {
+        f &= through | (through >> dirs[d]) | (through >> (2 * dirs[d])) |
+            (through >> (3 * dirs[d]));
+      }
+      if (f == 0) continue;
+      // The right-left diagonal starts at its highest bit.
+      const uint32_t start = __builtin_ctzll(f) + (d == 2 ? 3 * dirs[d] : 0);
+      const uint32_t key = start * 4 + d;
+      if (key >= best_key) continue;
+      best_key = key;
+      best_player = ids_[s];
+      for (int i = 0; i < 4; ++i) {
+        coords[i] = BitCoord(d == 2 ? start - i * dirs[d] : start + i * dirs[d]);
+      }
+    }
+  }
+  if (best_player == Winner::NONE) return Winner();
+  return Winner(best_player, coords);
+}
+
+bool BitBoard::Connected(const uint8_t p) const {
+  const int s = (ids_[0] == p ? 0 : (ids_[1] == p ? 1 : -1));
+  if (s < 0) return false;
+  const uint32_t h1 = rows_ + 1;
+  return (Fours(disc_[s], 1) | Fours(disc_[s], h1) |
+          Fours(disc_[s], h1 - 1) | Fours(disc_[s], h1 + 1)) != 0;
+}
+
+bool BitBoard::CheckFull() const {
+  const uint64_t mask = disc_[0] | disc_[1];
+  for (uint16_t col = 0; col < cols_; ++col) {
+    if ((mask & ColumnMask(col)) != ColumnMask(col)) return false;
+  }
+  return true;
+}
+
+std::vector<std::pair<uint32_t, BitBoard> > BitBoard::Expand(
+    const uint8_t player) const {
+  std::vector<std::pair<uint32_t, BitBoard> > children;
+  children.reserve(cols_);
+  for (uint16_t col = 0; col < cols_; ++col) {
+    if (Height(col) >= rows_) continue;
+    BitBoard ch(*this);
+    ch.Move(col, player);
+    children.push_back(std::pair<uint32_t, BitBoard>(col, ch));
+  }
+  return children;
+}
+
+// Same wire format as Board::Serialize.
+void BitBoard::Serialize(char** buff, size_t* size) const {
+  CHECK_NOTNULL(buff); CHECK_NOTNULL(size);
+  *size = cols_ * rows_ * sizeof(uint8_t) + 2 * sizeof(uint16_t);
+  *buff = new char[*size];
+  char* cols_pos = *buff;
+  char* rows_pos = cols_pos + sizeof(uint16_t);
+  char* board_pos = rows_pos + sizeof(uint16_t);
+  memcpy(cols_pos, (char*)&cols_, sizeof(uint16_t));
+  memcpy(rows_pos, (char*)&rows_, sizeof(uint16_t));
+  for (uint16_t r = 0; r < rows_; ++r) {
+    for (uint16_t c = 0; c < cols_; ++c) {
+      board_pos[c + r * cols_] = Get(c, r);
+    }
+  }
+}
+
+bool BitBoard::Deserialize(const char* buff, const size_t size) {
+  CHECK_NOTNULL(buff);
+  if (size < 2 * sizeof(uint16_t)) return false;
+  const char* cols_pos = buff;
+  const char* rows_pos = cols_pos + sizeof(uint16_t);
+  const char* board_pos = rows_pos + sizeof(uint16_t);
+  uint16_t cols = 0, rows = 0;
+  memcpy((char*)(&cols), cols_pos, sizeof(uint16_t));
+  memcpy((char*)(&rows), rows_pos, sizeof(uint16_t));
+  if (!Fits(cols, rows)) return false;
+  const size_t exp_size = cols * rows * sizeof(uint8_t) +
+      2 * sizeof(uint16_t);
+  if (size != exp_size) return false;
+  BitBoard b(cols, rows);
+  for (uint16_t c = 0; c < cols; ++c) {
+    uint16_t r = 0;
+    for (; r < rows && board_pos[c + r * cols] != ' '; ++r) {
+      const int s = b.Slot(board_pos[c + r * cols]);
+      if (s < 0) return false;
+      b.disc_[s] |= b.Bit(c, r);
+      b.hash_ ^= Zobrist::Cell(c, r, b.ids_[s]);
+      b.mirror_hash_ ^= Zobrist::Cell(cols - 1 - c, r, b.ids_[s]);
+    }
+    // No floating discs.
+    for (; r < rows; ++r) {
+      if (board_pos[c + r * cols] != ' ') return false;
+    }
+  }
+  *this = b;
+  return true;
+}
+
+void BitBoard::Print(std::ostream& os, const size_t sp) const {
+  for (size_t s = 0; s < sp; ++s) os << ' ';
+  for (uint16_t c = 0; c < cols_; ++c)
+    os << '-';
+  os << std::endl;
+  for (uint16_t r1 = rows_; r1 > 0; --r1) {
+    const uint16_t r = r1 - 1;
+    for (size_t s = 0; s < sp; ++s) os << ' ';
+    for (uint16_t c = 0; c < cols_; ++c) {
+      const uint8_t p = Get(c, r);
+      os << p;
+    }
+    os << std::endl;
+  }
+  for (size_t s = 0; s < sp; ++s) os << ' ';
+  for (uint16_t c = 0; c < cols_; ++c)
+    os << '-';
+  os << std::endl;
+}
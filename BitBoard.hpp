@@ -0,0 +1,196 @@
+#ifndef BITBOARD_HPP_
+#define BITBOARD_HPP_
+
+#include "Board.hpp"
+#include "Coord.hpp"
+#include "Winner.hpp"
+#include "Zobrist.hpp"
+
+#include <glog/logging.h>
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+#include <utility>
+
+// Board representation based on two 64-bit masks, one per player. Each
+// column uses rows + 1 bits (the extra bit is always empty and acts as a
+// separator), so only boards with cols * (rows + 1) <= 64 are supported
+// (e.g. 7x6 or 8x7). It offers the same interface as Board.
+class BitBoard {
+ public:
+  static bool Fits(const uint16_t cols, const uint16_t rows);
+  // Mask of the mirror image of a position of a cols x rows board in this
+  // layout: the columns (with their extra bit) in reverse order.
+  static uint64_t Mirror(const uint64_t mask, const uint16_t cols,
+                         const uint16_t rows);
+  BitBoard(const uint16_t cols, const uint16_t rows);
+  explicit BitBoard(const Board& board);
+  bool operator == (const BitBoard& other) const;
+  bool Move(const uint32_t move_id, const uint8_t p);
+  bool Undo(const uint32_t move_id);
+  Winner CheckWinner() const;
+  // Same as Board::CheckWinnerAt.
+  Winner CheckWinnerAt(const uint16_t col) const;
+  // Whether the top disc of the column is part of a four-in-a-row.
+  inline bool WinsAt(const uint16_t col) const {
+    if (col >= cols_) return false;
+    const uint64_t column = (disc_[0] | disc_[1]) & ColumnMask(col);
+    if (column == 0) return false;
+    const uint64_t bit = UINT64_C(1) << (63 - __builtin_clzll(column));
+    const uint64_t pos = (disc_[0] & bit) ? disc_[0] : disc_[1];
+    const uint32_t h1 = rows_ + 1;
+    const uint32_t dirs[4] = {1, h1, h1 - 1, h1 + 1};
+    for (int d = 0; d < 4; ++d) {
+      const uint64_t near = bit | (bit >> dirs[d]) | (bit >> (2 * dirs[d])) |
+          (bit >> (3 * dirs[d]));
+      if ((Fours(pos, dirs[d]) & near) != 0) return true;
+    }
+    return false;
+  }
+  bool Connected(const uint8_t p) const;
+  std::vector<std::pair<uint32_t,BitBoard> > Expand(const uint8_t player) const;
+  void Serialize(char** buff, size_t* size) const;
+  bool Deserialize(const char* buff, const size_t size);
+  bool CheckFull() const;
+  void Print(std::ostream& os, const size_t sp) const;
+  inline uint16_t Cols() const { return cols_; }
+  inline uint16_t Rows() const { return rows_; }
+  inline uint64_t Hash() const { return hash_; }
+  // Same as in Board.
+  inline uint64_t MirrorHash() const { return mirror_hash_; }
+  inline uint64_t CanonicalHash() const {
+    return mirror_hash_ < hash_ ? mirror_hash_ : hash_;
+  }
+  inline bool Mirrored() const { return mirror_hash_ < hash_; }
+  inline bool Symmetric() const { return mirror_hash_ == hash_; }
+  // Mask of the cells of player p.
+  inline uint64_t Discs(const uint8_t p) const {
+    return ids_[0] == p ? disc_[0] : (ids_[1] == p ? disc_[1] : 0);
+  }
+  // Key of the position with player p to move, independent of the player
+  // ids: the discs of p plus all the discs (unique thanks to the sentinel
+  // bits). Same key as the Solver's.
+  inline uint64_t Key(const uint8_t p) const {
+    return Discs(p) + (disc_[0] | disc_[1]);
+  }
+  // The smaller of the keys of the position and of its mirror image (the
+  // carries of Key stay in each column, so the mirror of the key is the
+  // key of the mirror). The opening book keys.
+  inline uint64_t CanonicalKey(const uint8_t p) const {
+    const uint64_t key = Key(p), mirror = Mirror(key, cols_, rows_);
+    return mirror < key ? mirror : key;
+  }
+  // Whether the canonical key is the one of the mirror image.
+  inline bool MirroredKey(const uint8_t p) const {
+    return Mirror(Key(p), cols_, rows_) < Key(p);
+  }
+  inline uint16_t Height(const uint16_t col) const {
+    return __builtin_popcountll((disc_[0] | disc_[1]) & ColumnMask(col));
+  }
+  inline uint8_t Get(const uint16_t col, const uint16_t row) const {
+    const uint64_t b = Bit(col, row);
+    if (disc_[0] & b) return ids_[0];
+    if (disc_[1] & b) return ids_[1];
+    return ' ';
+  }
+  friend std::ostream& operator << (std::ostream& os, const BitBoard& b) {
+    b.Print(os, 0);
+    return os;
+  }
+ protected:
+  uint64_t disc_[2];
+  uint64_t hash_;
+  uint64_t mirror_hash_;
+  uint16_t cols_;
+  uint16_t rows_;
+  uint8_t ids_[2];
+  // Four discs in a row along direction d, starting at the returned bits.
+  static inline uint64_t Fours(const uint64_t pos, const uint32_t d) {
+    const uint64_t m = pos & (pos >> d);
+    return m & (m >> (2 * d));
+  }
+  inline uint64_t Bit(const uint16_t col, const uint16_t row) const {
+    return UINT64_C(1) << (col * (rows_ + 1) + row);
+  }
+  inline uint64_t ColumnMask(const uint16_t col) const {
+    return ((UINT64_C(1) << rows_) - 1) << (col * (rows_ + 1));
+  }
+  int Slot(const uint8_t p);
+  Winner FindWinner(const uint64_t through) const;
+  Coord BitCoord(const uint32_t bit) const;
+};
+
+// BitBoard of a size known at compile time, for the most common board
+// sizes. It hides the methods used at every node of a search with versions
+// where the size is a constant, so masks and shifts are folded and loops
+// over the columns unrolled. Searches templated on the board type use them
+// without any dispatch.
+template <uint16_t C, uint16_t R>
+class FixedBitBoard : public BitBoard {
+ public:
+  static_assert(C * (R + 1) <= 64, "The board does not fit in a BitBoard");
+  FixedBitBoard() : BitBoard(C, R) {}
+  explicit FixedBitBoard(const Board& board) : BitBoard(board) {
+    CHECK(board.Cols() == C && board.Rows() == R)
+        << "Board " << board.Cols() << "x" << board.Rows() << " is not "
+        << C << "x" << R;
+  }
+  inline bool Move(const uint32_t move_id, const uint8_t p) {
+    if (move_id >= C || Height(move_id) >= R) {
+      return BitBoard::Move(move_id, p);  // Logs the error.
+    }
+    const int s = (ids_[0] == p ? 0 : (ids_[1] == p ? 1 : -1));
+    if (s < 0) return BitBoard::Move(move_id, p);
+    const uint16_t row = Height(move_id);
+    disc_[s] |= Bit(move_id, row);
+    hash_ ^= Zobrist::Cell(move_id, row, p);
+    mirror_hash_ ^= Zobrist::Cell(C - 1 - move_id, row, p);
+    return true;
+  }
+  inline bool Undo(const uint32_t move_id) {
+    if (move_id >= C || Height(move_id) == 0) {
+      return BitBoard::Undo(move_id);  // Logs the error.
+    }
+    const uint16_t row = Height(move_id) - 1;
+    const uint64_t top = Bit(move_id, row);
+    const uint8_t p = (disc_[0] & top) ? ids_[0] : ids_[1];
+    hash_ ^= Zobrist::Cell(move_id, row, p);
+    mirror_hash_ ^= Zobrist::Cell(C - 1 - move_id, row, p);
+    disc_[0] &= ~top;
+    disc_[1] &= ~top;
+    return true;
+  }
+  inline bool WinsAt(const uint16_t col) const {
+    if (col >= C) return false;
+    const uint64_t column = (disc_[0] | disc_[1]) & ColumnMask(col);
+    if (column == 0) return false;
+    const uint64_t bit = UINT64_C(1) << (63 - __builtin_clzll(column));
+    const uint64_t pos = (disc_[0] & bit) ? disc_[0] : disc_[1];
+    return Through(pos, bit, 1) || Through(pos, bit, R + 1) ||
+        Through(pos, bit, R) || Through(pos, bit, R + 2);
+  }
+  inline uint16_t Cols() const { return C; }
+  inline uint16_t Rows() const { return R; }
+  inline uint16_t Height(const uint16_t col) const {
+    return __builtin_popcountll((disc_[0] | disc_[1]) & ColumnMask(col));
+  }
+ private:
+  static inline uint64_t Bit(const uint16_t col, const uint16_t row) {
+    return UINT64_C(1) << (col * (R + 1) + row);
+  }
+  static inline uint64_t ColumnMask(const uint16_t col) {
+    return ((UINT64_C(1) << R) - 1) << (col * (R + 1));
+  }
+  // Whether a four-in-a-row of pos along direction d contains bit.
+  static inline bool Through(const uint64_t pos, const uint64_t bit,
+                             const uint32_t d) {
+    const uint64_t near = bit | (bit >> d) | (bit >> (2 * d)) |
+        (bit >> (3 * d));
+    return (Fours(pos, d) & near) != 0;
+  }
+};
+
+typedef FixedBitBoard<7, 6> BitBoard7x6;
+typedef FixedBitBoard<8, 7> BitBoard8x7;
+
+#endif  // BITBOARD_HPP_
@@ -7,14 +7,15 @@
 
 Board::Board(const uint16_t cols, const uint16_t rows)
     : cols_(cols), rows_(rows), board_(new uint8_t[cols_ * rows_]),
-      height_(new uint16_t[cols_]) {
+      height_(new uint16_t[cols_]), hash_(0), mirror_hash_(0) {
   memset(board_, ' ', sizeof(uint8_t) * cols_ * rows_);
   memset(height_, 0x00, sizeof(uint16_t) * cols_);
 }
 
 Board::Board(const Board& board)
     : cols_(board.cols_), rows_(board.rows_),
-      board_(new uint8_t[cols_ * rows_]), height_(new uint16_t[cols_]) {
+      board_(new uint8_t[cols_ * rows_]), height_(new uint16_t[cols_]),
+      hash_(board.hash_), mirror_hash_(board.mirror_hash_) {
   memcpy(board_, board.board_, sizeof(uint8_t) * cols_ * rows_);
   memcpy(height_, board.height_, sizeof(uint16_t) * cols_);
 }
@@ -31,6 +32,8 @@ Board& Board::operator = (const Board& board) {
   rows_ = board.rows_;
   board_ = new uint8_t[cols_ * rows_];
   height_ = new uint16_t[cols_];
+  hash_ = board.hash_;
+  mirror_hash_ = board.mirror_hash_;
   memcpy(board_, board.board_, sizeof(uint8_t) * cols_ * rows_);
   memcpy(height_, board.height_, sizeof(uint16_t) * cols_);
   return *this;
@@ -56,6 +59,22 @@ bool Board::Move(const uint32_t move_id, const uint8_t p) {
   const uint32_t idx = col + row * cols_;
   board_[idx] = p;
   ++height_[col];
+  hash_ ^= Zobrist::Cell(col, row, p);
+  mirror_hash_ ^= Zobrist::Cell(cols_ - 1 - col, row, p);
+  return true;
+}
+
+bool Board::Undo(const uint32_t move_id) {
+  if (move_id >= cols_ || height_[move_id] == 0) {
+    LOG(INFO) << "Cannot undo a move at column " << move_id;
+    return false;
+  }
+  const uint16_t col = move_id;
+  --height_[col];
+  const uint32_t idx = col + height_[col] * cols_;
+  hash_ ^= Zobrist::Cell(col, height_[col], board_[idx]);
+  mirror_hash_ ^= Zobrist::Cell(cols_ - 1 - col, height_[col], board_[idx]);
+  board_[idx] = ' ';
   return true;
 }
 
@@ -98,6 +117,40 @@ Winner Board::CheckWinner() const {
   return Winner();
 }
 
+Winner Board::CheckWinnerAt(const uint16_t col) const {
+  if (col >= cols_ || height_[col] == 0) return Winner();
+  const int c0 = col, r0 = height_[col] - 1;
+  const uint8_t p = Get(c0, r0);
+  // Directions in the order CheckWinner tests them. Each window is
+  // identified by the cell CheckWinner starts it from (its bottom cell, or
+  // the left one for horizontal windows), and the one CheckWinner would
+  // find first is reported.
+  const int dirs[4][2] = {{0, 1}, {1, 0}, {-1, 1}, {1, 1}};
+  const auto owned = [&](const int c, const int r) {
+    return c >= 0 && c < cols_ && r >= 0 && r < rows_ && Get(c, r) == p;
+  };
+  int best_key = -1;
+  Coord coords[4];
+  for (int d = 0; d < 4; ++d) {
+    const int dc = dirs[d][0], dr = dirs[d][1];
+    // Run of discs of p through the new one, from offset lo to hi.
+    int lo = 0, hi = 0;
+    while (lo > -3 && owned(c0 + (lo - 1) * dc, r0 + (lo - 1) * dr)) --lo;
+    while (hi < 3 && owned(c0 + (hi + 1) * dc, r0 + (hi + 1) * dr)) ++hi;
+    for (int s = lo; s + 3 <= hi; ++s) {
+      const int sc = c0 + s * dc, sr = r0 + s * dr;
+      const int key = (sc * rows_ + sr) * 4 + d;
+      if (best_key >= 0 && key >= best_key) continue;
+      best_key = key;
+      for (int i = 0; i < 4; ++i) {
+        coords[i] = Coord(sc + i * dc, sr + i * dr);
+      }
+    }
+  }
+  if (best_key < 0) return Winner();
+  return Winner(p, coords);
+}
+
 bool Board::CheckFull() const {
   for (uint16_t col = 0; col < cols_; ++col) {
     if (height_[col] < rows_) return false;
@@ -134,24 +187,143 @@ bool Board::Deserialize(const char* buff, const size_t size) {
   if (size < 2 * sizeof(uint16_t)) return false;
   const char* cols_pos = buff;
   const char* rows_pos = cols_pos + sizeof(uint16_t);
-  const char* board_pos = rows_pos + sizeof(uint16_t);
-  memcpy((char*)(&cols_), cols_pos, sizeof(uint16_t));
-  memcpy((char*)(&rows_), rows_pos, sizeof(uint16_t));
-  if (cols_ == 0 || rows_ == 0) return false;
-  const size_t exp_size = cols_ * rows_ * sizeof(uint8_t) +
+  const uint8_t* board_pos = (const uint8_t*)(rows_pos + sizeof(uint16_t));
+  uint16_t cols = 0, rows = 0;
+  memcpy((char*)(&cols), cols_pos, sizeof(uint16_t));
+  memcpy((char*)(&rows), rows_pos, sizeof(uint16_t));
+  if (cols == 0 || rows == 0) return false;
+  const size_t exp_size = cols * rows * sizeof(uint8_t) +
       2 * sizeof(uint16_t);
   if (size != exp_size) return false;
-  height_ = new uint16_t[cols_];
-  board_ = new uint8_t[cols_ * rows_];
-  memcpy((char*)board_, board_pos, cols_ * rows_ * sizeof(uint16_t));
+  // No floating discs.
+  for (uint16_t c = 0; c < cols; ++c) {
+    uint16_t r = 0;
+    while (r < rows && board_pos[c + r * cols] != ' ') ++r;
+    for (; r < rows; ++r) {
+      if (board_pos[c + r * cols] != ' ') return false;
+    }
+  }
+  Resize(cols, rows);
+  memcpy((char*)board_, board_pos, cols_ * rows_ * sizeof(uint8_t));
+  hash_ = 0;
+  mirror_hash_ = 0;
   for (uint16_t c = 0; c < cols_; ++c) {
     height_[c] = 0;
     for (uint16_t r = 0; r < rows_ && board_[c + r * cols_] != ' ';
-         ++r, ++height_[c]);
+         ++r, ++height_[c]) {
+      hash_ ^= Zobrist::Cell(c, r, board_[c + r * cols_]);
+      mirror_hash_ ^= Zobrist::Cell(cols_ - 1 - c, r, board_[c + r * cols_]);
+    }
   }
   return true;
 }
 
+void Board::Resize(const uint16_t cols, const uint16_t rows) {
+  if (cols == cols_ && rows == rows_) return;
+  delete [] board_;
+  delete [] height_;
+  cols_ = cols;
+  rows_ = rows;
+  board_ = new uint8_t[cols_ * rows_];
+  height_ = new uint16_t[cols_];
+}
+
+size_t Board::EncodedSize(const uint16_t cols, const uint16_t rows) {
+  return kWireHeaderSize + (size_t(cols) * (rows + 1) + 7) / 8;
+}
+
+bool Board::DecodeHeader(const char* buff, const size_t size,
+                         uint16_t* cols, uint16_t* rows) {
+  CHECK_NOTNULL(buff); CHECK_NOTNULL(cols); CHECK_NOTNULL(rows);
+  if (size < kWireHeaderSize) return false;
+  const uint8_t* p = (const uint8_t*)buff;
+  *cols = p[1] | (p[2] << 8);
+  *rows = p[3] | (p[4] << 8);
+  return p[0] == kWireVersion && *cols > 0 && *rows > 0 && p[5] != ' ' &&
+      p[6] != ' ' && p[5] != p[6];
+}
+
+size_t Board::Encode(char* buff, const size_t size) const {
+  CHECK_NOTNULL(buff);
+  const size_t n = EncodedSize(cols_, rows_);
+  if (size < n) return 0;
+  // Ids of the discs on the board, filled up with O and X.
+  uint8_t ids[2] = {' ', ' '};
+  size_t num_ids = 0;
+  for (uint16_t c = 0; c < cols_; ++c) {
+    for (uint16_t r = 0; r < height_[c]; ++r) {
+      const uint8_t p = board_[c + r * cols_];
+      if (num_ids > 0 && ids[0] == p) continue;
+      if (num_ids > 1 && ids[1] == p) continue;
+      if (num_ids == 2) return 0;
+      ids[num_ids++] = p;
+    }
+  }
+  if (num_ids < 2 && ids[0] != 'O') { ids[num_ids++] = 'O'; }
+  if (num_ids < 2) { ids[num_ids++] = 'X'; }
+  if (ids[0] > ids[1]) std::swap(ids[0], ids[1]);
+  uint8_t* p = (uint8_t*)buff;
+  p[0] = kWireVersion;
+  p[1] = cols_ & 0xFF;
+  p[2] = cols_ >> 8;
+  p[3] = rows_ & 0xFF;
+  p[4] = rows_ >> 8;
+  p[5] = ids[0];
+  p[6] = ids[1];
+  uint8_t* bits = p + kWireHeaderSize;
+  memset(bits, 0, n - kWireHeaderSize);
+  size_t bit = 0;
+  for (uint16_t c = 0; c < cols_; ++c, bit += rows_ + 1) {
+    const uint16_t h = height_[c];
+    for (uint16_t r = 0; r < h; ++r) {
+      if (board_[c + r * cols_] == ids[1]) {
+        bits[(bit + r) >> 3] |= 1 << ((bit + r) & 7);
+      }
+    }
+    bits[(bit + h) >> 3] |= 1 << ((bit + h) & 7);
+  }
+  return n;
+}
+
+size_t Board::Decode(const char* buff, const size_t size) {
+  uint16_t cols = 0, rows = 0;
+  if (!DecodeHeader(buff, size, &cols, &rows)) return 0;
+  const size_t n = EncodedSize(cols, rows);
+  if (size < n) return 0;
+  const uint8_t* p = (const uint8_t*)buff;
+  const uint8_t ids[2] = {p[5], p[6]};
+  const uint8_t* bits = p + kWireHeaderSize;
+  // Every column needs its top bit, and the padding of the last byte must
+  // be clear.
+  size_t bit = 0;
+  for (uint16_t c = 0; c < cols; ++c, bit += rows + 1) {
+    bool top = false;
+    for (uint16_t r = 0; r <= rows && !top; ++r) {
+      top = (bits[(bit + r) >> 3] >> ((bit + r) & 7)) & 1;
+    }
+    if (!top) return 0;
+  }
+  if (bit & 7 && bits[bit >> 3] >> (bit & 7)) return 0;
+  Resize(cols, rows);
+  memset(board_, ' ', sizeof(uint8_t) * cols_ * rows_);
+  hash_ = 0;
+  mirror_hash_ = 0;
+  bit = 0;
+  for (uint16_t c = 0; c < cols_; ++c, bit += rows_ + 1) {
+    // The top bit is the highest one of the column.
+    uint16_t h = rows_;
+    while (!((bits[(bit + h) >> 3] >> ((bit + h) & 7)) & 1)) --h;
+    height_[c] = h;
+    for (uint16_t r = 0; r < h; ++r) {
+      const uint8_t d = ids[(bits[(bit + r) >> 3] >> ((bit + r) & 7)) & 1];
+      board_[c + r * cols_] = d;
+      hash_ ^= Zobrist::Cell(c, r, d);
+      mirror_hash_ ^= Zobrist::Cell(cols_ - 1 - c, r, d);
+    }
+  }
+  return n;
+}
+
 void Board::Print(std::ostream& os, const size_t sp) const {
   for (size_t s = 0; s < sp; ++s) os << ' ';
   for (uint16_t c = 0; c < cols_; ++c)
@@ -171,3 +343,42 @@ void Board::Print(std::ostream& os, const size_t sp) const {
     os << '-';
   os << std::endl;
 }
+
+size_t EncodeBoards(const std::vector<Board>& boards, char* buff,
+                    const size_t size) {
+  CHECK_NOTNULL(buff);
+  CHECK_LE(boards.size(), UINT32_MAX);
+  if (size < sizeof(uint32_t)) return 0;
+  const uint32_t count = boards.size();
+  uint8_t* p = (uint8_t*)buff;
+  for (size_t i = 0; i < sizeof(uint32_t); ++i) { p[i] = count >> (8 * i); }
+  size_t n = sizeof(uint32_t);
+  for (size_t i = 0; i < boards.size(); ++i) {
+    const size_t b = boards[i].Encode(buff + n, size - n);
+    if (b == 0) return 0;
+    n += b;
+  }
+  return n;
+}
+
+size_t DecodeBoards(const char* buff, const size_t size,
+                    std::vector<Board>* boards) {
+  CHECK_NOTNULL(buff); CHECK_NOTNULL(boards);
+  if (size < sizeof(uint32_t)) return 0;
+  const uint8_t* p = (const uint8_t*)buff;
+  uint32_t count = 0;
+  for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+    count |= uint32_t(p[i]) << (8 * i);
+  }
+  size_t n = sizeof(uint32_t);
+  for (uint32_t i = 0; i < count; ++i) {
+    uint16_t cols = 0, rows = 0;
+    if (!Board::DecodeHeader(buff + n, size - n, &cols, &rows)) return 0;
+    if (i >= boards->size()) { boards->push_back(Board(cols, rows)); }
+    const size_t b = (*boards)[i].Decode(buff + n, size - n);
+    if (b == 0) return 0;
+    n += b;
+  }
+  boards->erase(boards->begin() + count, boards->end());
+  return n;
+}
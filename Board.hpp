@@ -3,6 +3,7 @@
 
 #include "Coord.hpp"
 #include "Winner.hpp"
+#include "Zobrist.hpp"
 
 #include <glog/logging.h>
 #include <stdint.h>
@@ -14,18 +15,60 @@ class Board {
  public:
   Board(const uint16_t cols, const uint16_t rows);
   Board(const Board& board);
-  virtual ~Board();
-  virtual Board& operator = (const Board& other);
-  virtual bool operator == (const Board& other) const;
-  virtual bool Move(const uint32_t move_id, const uint8_t p);
-  virtual Winner CheckWinner() const;
-  virtual std::vector<std::pair<uint32_t,Board> > Expand(const uint8_t player) const;
-  virtual void Serialize(char** buff, size_t* size) const;
-  virtual bool Deserialize(const char* buff, const size_t size);
-  virtual bool CheckFull() const;
+  ~Board();
+  Board& operator = (const Board& other);
+  bool operator == (const Board& other) const;
+  bool Move(const uint32_t move_id, const uint8_t p);
+  bool Undo(const uint32_t move_id);
+  Winner CheckWinner() const;
+  // Winner through the top disc of the column, i.e. the last one placed
+  // there. It reports the same cells as CheckWinner when the disc creates
+  // the only four-in-a-row of the board.
+  Winner CheckWinnerAt(const uint16_t col) const;
+  inline bool WinsAt(const uint16_t col) const {
+    return CheckWinnerAt(col).player != Winner::NONE;
+  }
+  std::vector<std::pair<uint32_t,Board> > Expand(const uint8_t player) const;
+  // One byte per cell, with cols and rows in front. Serialize allocates
+  // *buff, which the caller deletes.
+  void Serialize(char** buff, size_t* size) const;
+  bool Deserialize(const char* buff, const size_t size);
+  // Compact wire format: a header with the version, cols and rows (uint16,
+  // little-endian) and the two player ids, followed by rows + 1 bits per
+  // column, starting at the bottom: one bit per disc (set for the second
+  // id) and a set bit on top of them. Encode writes it into buff and
+  // returns its size, or 0 if buff is too small or the board has more than
+  // two players. Decode reuses the memory of the board when the size does
+  // not change, and returns the bytes read, or 0 (leaving the board as it
+  // was) if buff does not start with a whole valid board.
+  static const uint8_t kWireVersion = 1;
+  static const size_t kWireHeaderSize = 7;
+  static size_t EncodedSize(const uint16_t cols, const uint16_t rows);
+  // Reads the size of the board from the header. Returns false if buff is
+  // shorter than the header, or it is not a valid one.
+  static bool DecodeHeader(const char* buff, const size_t size,
+                           uint16_t* cols, uint16_t* rows);
+  size_t Encode(char* buff, const size_t size) const;
+  size_t Decode(const char* buff, const size_t size);
+  bool CheckFull() const;
   void Print(std::ostream& os, const size_t sp) const;
   inline uint16_t Cols() const { return cols_; }
   inline uint16_t Rows() const { return rows_; }
+  inline uint64_t Hash() const { return hash_; }
+  // Hash of the mirror image of the position (columns in reverse order).
+  // A position and its mirror image have the same canonical hash, the
+  // smaller of both hashes, and the same value, so they share the entries
+  // of the caches. The moves stored under a Mirrored position are the
+  // mirror images of its moves (cols - 1 - col). A Symmetric position is
+  // its own mirror image.
+  inline uint64_t MirrorHash() const { return mirror_hash_; }
+  inline uint64_t CanonicalHash() const {
+    return mirror_hash_ < hash_ ? mirror_hash_ : hash_;
+  }
+  inline bool Mirrored() const { return mirror_hash_ < hash_; }
+  inline bool Symmetric() const { return mirror_hash_ == hash_; }
+  // Cells of the board, one byte per cell at col + row * cols.
+  inline const uint8_t* Data() const { return board_; }
   inline uint16_t Height(const uint16_t col) const {
     CHECK_LT(col, cols_);
     return height_[col];
@@ -39,10 +82,24 @@ class Board {
     return os;
   }
  private:
+  // Makes room for a cols x rows board. The cells are left as they were
+  // when the size does not change, and undefined otherwise.
+  void Resize(const uint16_t cols, const uint16_t rows);
   uint16_t cols_;
   uint16_t rows_;
   uint8_t* board_;
   uint16_t* height_;
+  uint64_t hash_;
+  uint64_t mirror_hash_;
 };
 
+// Batches of boards in the compact wire format: the number of boards
+// (uint32, little-endian) followed by the boards. Both return the bytes
+// written or read, or 0 on failure. DecodeBoards reuses the boards already
+// in the vector.
+size_t EncodeBoards(const std::vector<Board>& boards, char* buff,
+                    const size_t size);
+size_t DecodeBoards(const char* buff, const size_t size,
+                    std::vector<Board>* boards);
+
 #endif  // BOARD_HPP_
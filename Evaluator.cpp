@@ -0,0 +1,112 @@
+#include "Evaluator.hpp"
+
+#include <glog/logging.h>
+#include <cmath>
+#include <cstring>
+
+float SimpleEvaluator::operator () (
+    const uint8_t pa, const uint8_t pb) const {
+  if (winner_ == pa) return +INFINITY;
+  if (winner_ == pb) return -INFINITY;
+  return 0.0f;
+}
+
+WeightEvaluator::WeightEvaluator(
+    const float weights[6], const uint16_t cols, const uint16_t rows,
+    const uint8_t pa, const uint8_t pb)
+    : cols_(cols), rows_(rows), ids_{pa, pb}, cell_start_(cols * rows + 1, 0) {
+  // Same expression as WeightHeuristic::LineHeuristic.
+  for (size_t k = 1; k < 4; ++k) {
+    line_score_[0][k] = (k/3) * weights[2] + (k/2) * weights[1] + k * weights[0];
+    line_score_[1][k] = (k/3) * weights[5] + (k/2) * weights[4] + k * weights[3];
+  }
+  line_score_[0][0] = line_score_[1][0] = 0.0f;
+  // Enumerate the windows (vertical, horizontal and both diagonals) and
+  // build the list of windows through each cell.
+  std::vector<std::vector<uint32_t> > windows(cols_ * rows_);
+  uint32_t num_windows = 0;
+  const int dirs[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+  for (int c = 0; c < cols_; ++c) {
+    for (int r = 0; r < rows_; ++r) {
+      for (int d = 0; d < 4; ++d) {
+        const int ec = c + 3 * dirs[d][0], er = r + 3 * dirs[d][1];
+        if (ec < 0 || ec >= cols_ || er < 0 || er >= rows_) continue;
+        for (int i = 0; i < 4; ++i) {
+          const int cc = c + i * dirs[d][0], rr = r + i * dirs[d][1];
+          windows[cc + rr * cols_].push_back(num_windows);
+        }
+        ++num_windows;
+      }
+    }
+  }
+  for (size_t i = 0; i < windows.size(); ++i) {
+    cell_start_[i + 1] = cell_start_[i] + windows[i].size();
+    cell_windows_.insert(cell_windows_.end(), windows[i].begin(),
+                         windows[i].end());
+  }
+  count_[0].resize(num_windows);
+  count_[1].resize(num_windows);
+  memset(single_, 0x00, sizeof(single_));
+}
+
+template <class B>
+void WeightEvaluator::ResetFrom(const B& b) {
+  CHECK_EQ(b.Cols(), cols_); CHECK_EQ(b.Rows(), rows_);
+  std::fill(count_[0].begin(), count_[0].end(), 0);
+  std::fill(count_[1].begin(), count_[1].end(), 0);
+  memset(single_, 0x00, sizeof(single_));
+  for (uint16_t c = 0; c < cols_; ++c) {
+    for (uint16_t r = 0; r < b.Height(c); ++r) {
+      const uint8_t p = b.Get(c, r);
+      if (p == ids_[0]) { Update(c, r, 0, +1); }
+      else if (p == ids_[1]) { Update(c, r, 1, +1); }
+    }
+  }
+}
+
+void WeightEvaluator::Reset(const Board& b) {
+  ResetFrom(b);
+}
+
+void WeightEvaluator::Reset(const BitBoard& b) {
+  ResetFrom(b);
+}
+
+void WeightEvaluator::Update(const uint16_t col, const uint16_t row,
+                             const int s, const int delta) {
+  const uint32_t cell = col + row * cols_;
+  for (uint32_t i = cell_start_[cell]; i < cell_start_[cell + 1]; ++i) {
+    const uint32_t w = cell_windows_[i];
+    uint8_t& own = count_[s][w];
+    const uint8_t opp = count_[1 - s][w];
+    // Only non-empty windows with discs of a single player are counted.
+    if (opp == 0) { if (own > 0) --single_[s][own]; }
+    else if (own == 0) { --single_[1 - s][opp]; }
+    own += delta;
+    if (opp == 0) { if (own > 0) ++single_[s][own]; }
+    else if (own == 0) { ++single_[1 - s][opp]; }
+  }
+}
+
+void WeightEvaluator::Play(const uint16_t col, const uint16_t row,
+                           const uint8_t p) {
+  Update(col, row, p == ids_[0] ? 0 : 1, +1);
+}
+
+void WeightEvaluator::Undo(const uint16_t col, const uint16_t row,
+                           const uint8_t p) {
+  Update(col, row, p == ids_[0] ? 0 : 1, -1);
+}
+
+float WeightEvaluator::operator () (const uint8_t pa, const uint8_t pb) const {
+  const int a = (pa == ids_[0] ? 0 : 1);
+  const int b = 1 - a;
+  float score = 0.0f;
+  if (single_[a][4] > 0) { score += INFINITY; }
+  if (single_[b][4] > 0) { score -= INFINITY; }
+  for (size_t k = 1; k < 4; ++k) {
+    score += single_[a][k] * line_score_[0][k];
+    score += single_[b][k] * line_score_[1][k];
+  }
+  return score;
+}
@@ -0,0 +1,73 @@
+#ifndef EVALUATOR_HPP_
+#define EVALUATOR_HPP_
+
+#include "BitBoard.hpp"
+#include "Board.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+// Incremental evaluation state of a heuristic, carried by the search along
+// with the board: Play and Undo must be called after every move played and
+// before every move undone, respectively. Reset synchronizes the state with
+// a given board.
+class Evaluator {
+ public:
+  virtual ~Evaluator() {}
+  virtual void Reset(const Board& b) = 0;
+  virtual void Reset(const BitBoard& b) = 0;
+  virtual void Play(const uint16_t col, const uint16_t row, const uint8_t p) = 0;
+  virtual void Undo(const uint16_t col, const uint16_t row, const uint8_t p) = 0;
+  virtual float operator () (const uint8_t pa, const uint8_t pb) const = 0;
+};
+
+// Incremental SimpleHeuristic. The search detects the wins created by the
+// moves it plays and never plays past them, so the score only depends on
+// the winner of the board given to Reset.
+class SimpleEvaluator : public Evaluator {
+ public:
+  SimpleEvaluator() : winner_(Winner::NONE) {}
+  virtual void Reset(const Board& b) { winner_ = b.CheckWinner().player; }
+  virtual void Reset(const BitBoard& b) { winner_ = b.CheckWinner().player; }
+  virtual void Play(const uint16_t col, const uint16_t row, const uint8_t p) {}
+  virtual void Undo(const uint16_t col, const uint16_t row, const uint8_t p) {}
+  virtual float operator () (const uint8_t pa, const uint8_t pb) const;
+ private:
+  uint8_t winner_;
+};
+
+// Incremental WeightHeuristic. It keeps the number of discs of each player
+// in every 4-cell window of the board, and how many windows contain k discs
+// of a single player. A move only updates the windows through its cell,
+// and the score is computed from the per-k window counts in constant time.
+class WeightEvaluator : public Evaluator {
+ public:
+  WeightEvaluator(const float weights[6], const uint16_t cols,
+                  const uint16_t rows, const uint8_t pa, const uint8_t pb);
+  virtual void Reset(const Board& b);
+  virtual void Reset(const BitBoard& b);
+  virtual void Play(const uint16_t col, const uint16_t row, const uint8_t p);
+  virtual void Undo(const uint16_t col, const uint16_t row, const uint8_t p);
+  virtual float operator () (const uint8_t pa, const uint8_t pb) const;
+ private:
+  const uint16_t cols_;
+  const uint16_t rows_;
+  const uint8_t ids_[2];
+  // Score of a window with k discs of a single player, from the point of
+  // view of that player ([0]) and of its opponent ([1]).
+  float line_score_[2][4];
+  // Windows through each cell: cell_windows_[cell_start_[i]] to
+  // cell_windows_[cell_start_[i + 1]] for cell i = col + row * cols.
+  std::vector<uint32_t> cell_start_;
+  std::vector<uint32_t> cell_windows_;
+  // Discs of each player in each window.
+  std::vector<uint8_t> count_[2];
+  // Number of windows with k > 0 discs of player s only: single_[s][k].
+  uint32_t single_[2][5];
+  template <class B>
+  void ResetFrom(const B& b);
+  void Update(const uint16_t col, const uint16_t row, const int s,
+              const int delta);
+};
+
+#endif  // EVALUATOR_HPP_
@@ -0,0 +1,204 @@
+#include "GameCache.hpp"
+
+#include "Zobrist.hpp"
+
+#include <errno.h>
+#include <glog/logging.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char kMagic[8] = {'C', '4', 'G', 'A', 'M', 'E', 'S', '\0'};
+static const uint32_t kVersion = 2;
+// Magic, version, reserved and settings.
+static const size_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint32_t) +
+    sizeof(uint64_t);
+// Both weight vectors, cols, rows, depth, winner and rounds.
+static const size_t kRecordSize = 2 * 6 * sizeof(int16_t) +
+    2 * sizeof(uint16_t) + sizeof(uint32_t) + sizeof(int8_t) +
+    sizeof(uint16_t);
+
+bool GameCache::Key::operator == (const Key& o) const {
+  return memcmp(wa, o.wa, sizeof(wa)) == 0 &&
+      memcmp(wb, o.wb, sizeof(wb)) == 0 && cols == o.cols &&
+      rows == o.rows && depth == o.depth;
+}
+
+size_t GameCache::KeyHash::operator () (const Key& k) const {
+  uint64_t h = Zobrist::Mix((uint64_t(k.cols) << 48) |
+                            (uint64_t(k.rows) << 32) | k.depth);
+  for (int i = 0; i < 6; ++i) {
+    h = Zobrist::Mix(h ^ (uint64_t(uint16_t(k.wa[i])) << 16) ^
+                     uint16_t(k.wb[i]));
+  }
+  return h;
+}
+
+GameCache::GameCache() : file_(NULL) {}
+
+GameCache::~GameCache() {
+  if (file_ != NULL) {
+    Flush();
+    fclose(file_);
+  }
+}
+
+bool GameCache::Find(const Key& key, int* winner, int* rounds) const {
+  const Shard& s = shards_[KeyHash()(key) % kShards];
+  std::lock_guard<std::mutex> lock(s.mutex);
+  const std::unordered_map<Key, Value, KeyHash>::const_iterator it =
+      s.map.find(key);
+  if (it == s.map.end()) return false;
+  *winner = it->second.winner;
+  *rounds = it->second.rounds;
+  return true;
+}
+
+void GameCache::Insert(const Key& key, const int winner, const int rounds) {
+  Shard& s = shards_[KeyHash()(key) % kShards];
+  const Value v = {(int8_t)winner, (uint16_t)rounds};
+  std::lock_guard<std::mutex> lock(s.mutex);
+  if (!s.map.insert(std::make_pair(key, v)).second) return;
+  if (file_ != NULL) {
+    const Record r = {key, v};
+    s.pending.push_back(r);
+  }
+}
+
+size_t GameCache::Size() const {
+  size_t n = 0;
+  for (size_t i = 0; i < kShards; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    n += shards_[i].map.size();
+  }
+  return n;
+}
+
+bool GameCache::Open(const std::string& path, const uint64_t settings) {
+  CHECK(file_ == NULL) << "The game cache is already open";
+  file_ = fopen(path.c_str(), "a+b");
+  if (file_ == NULL) return false;
+  fseek(file_, 0, SEEK_SET);
+  char header[kHeaderSize];
+  const size_t n = fread(header, 1, sizeof(header), file_);
+  if (n == 0) {
+    // New file.
+    const uint32_t reserved = 0;
+    char* p = header;
+    memcpy(p, kMagic, sizeof(kMagic)); p += sizeof(kMagic);
+    memcpy(p, &kVersion, sizeof(kVersion)); p += sizeof(kVersion);
+    memcpy(p, &reserved, sizeof(reserved)); p += sizeof(reserved);
+    memcpy(p, &settings, sizeof(settings));
+    if (fwrite(header, sizeof(header), 1, file_) != 1 || fflush(file_) != 0) {
+      fclose(file_);
+      file_ = NULL;
+      return false;
+    }
+    return true;
+  }
+  uint32_t version = 0;
+  uint64_t file_settings = 0;
+  memcpy(&version, header + sizeof(kMagic), sizeof(version));
+  memcpy(&file_settings, header + kHeaderSize - sizeof(file_settings),
+         sizeof(file_settings));
+  if (n != sizeof(header) || memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+    LOG(WARNING) << "File \"" << path << "\" is not a game cache (or was "
+                 << "written by an older version)";
+  } else if (version != kVersion) {
+    LOG(WARNING) << "Game cache \"" << path << "\" has version " << version
+                 << " instead of " << kVersion;
+  } else if (file_settings != settings) {
+    LOG(WARNING) << "The games in \"" << path << "\" were played with other "
+                 << "settings or by another version of the engine";
+  } else {
+    return Load(path);
+  }
+  fclose(file_);
+  file_ = NULL;
+  return false;
+}
+
+bool GameCache::Load(const std::string& path) {
+  char buf[kRecordSize];
+  size_t records = 0;
+  while (fread(buf, kRecordSize, 1, file_) == 1) {
+    Key k;
+    int8_t winner;
+    uint16_t rounds;
+    const char* p = buf;
+    memcpy(k.wa, p, sizeof(k.wa)); p += sizeof(k.wa);
+    memcpy(k.wb, p, sizeof(k.wb)); p += sizeof(k.wb);
+    memcpy(&k.cols, p, sizeof(k.cols)); p += sizeof(k.cols);
+    memcpy(&k.rows, p, sizeof(k.rows)); p += sizeof(k.rows);
+    memcpy(&k.depth, p, sizeof(k.depth)); p += sizeof(k.depth);
+    memcpy(&winner, p, sizeof(winner)); p += sizeof(winner);
+    memcpy(&rounds, p, sizeof(rounds));
+    const Value v = {winner, rounds};
+    shards_[KeyHash()(k) % kShards].map.insert(std::make_pair(k, v));
+    ++records;
+  }
+  // Drop a record cut by a crash, so the next ones are aligned. Appends
+  // always go to the end of the file.
+  const long end = kHeaderSize + records * kRecordSize;
+  if (fseek(file_, 0, SEEK_END) == 0 && ftell(file_) != end) {
+    LOG(WARNING) << "Ignoring a truncated record at the end of \"" << path
+                 << "\"";
+    if (ftruncate(fileno(file_), end) != 0) {
+      fclose(file_);
+      file_ = NULL;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool GameCache::Flush() {
+  if (file_ == NULL) return false;
+  std::vector<char> buf;
+  // Records of each shard written, kept pending until the write succeeds.
+  size_t written[kShards];
+  for (size_t i = 0; i < kShards; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    const std::vector<Record>& pending = shards_[i].pending;
+    written[i] = pending.size();
+    for (size_t j = 0; j < pending.size(); ++j) {
+      const Record& r = pending[j];
+      const size_t o = buf.size();
+      buf.resize(o + kRecordSize);
+      char* p = buf.data() + o;
+      memcpy(p, r.key.wa, sizeof(r.key.wa)); p += sizeof(r.key.wa);
+      memcpy(p, r.key.wb, sizeof(r.key.wb)); p += sizeof(r.key.wb);
+      memcpy(p, &r.key.cols, sizeof(r.key.cols)); p += sizeof(r.key.cols);
+      memcpy(p, &r.key.rows, sizeof(r.key.rows)); p += sizeof(r.key.rows);
+      memcpy(p, &r.key.depth, sizeof(r.key.depth)); p += sizeof(r.key.depth);
+      memcpy(p, &r.value.winner, sizeof(r.value.winner));
+      p += sizeof(r.value.winner);
+      memcpy(p, &r.value.rounds, sizeof(r.value.rounds));
+    }
+  }
+  if (buf.empty()) return true;
+  // Written with the descriptor (opened for appending), so a failed write
+  // leaves nothing in the stdio buffer to be written again later.
+  const int fd = fileno(file_);
+  if (fflush(file_) != 0) return false;
+  const off_t end = lseek(fd, 0, SEEK_END);
+  if (end < 0) return false;
+  for (size_t o = 0; o < buf.size();) {
+    const ssize_t n = write(fd, buf.data() + o, buf.size() - o);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      // Drop a partial write, so the records are retried aligned.
+      if (ftruncate(fd, end) != 0) {
+        LOG(WARNING) << "The game cache could not be truncated after a "
+                     << "failed write";
+      }
+      return false;
+    }
+    o += n;
+  }
+  for (size_t i = 0; i < kShards; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    std::vector<Record>& pending = shards_[i].pending;
+    pending.erase(pending.begin(), pending.begin() + written[i]);
+  }
+  return true;
+}
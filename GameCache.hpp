@@ -0,0 +1,72 @@
+#ifndef GAME_CACHE_HPP_
+#define GAME_CACHE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Thread-safe cache of the results of deterministic games between two
+// weight heuristics, keyed by both weight vectors, the board size and the
+// search depth. The table is split in shards with a lock each, so threads
+// rarely wait for each other.
+// It can be backed by a file: Open loads the results stored in it and
+// Flush appends the ones inserted since, so results survive between runs.
+// The file is a header followed by fixed-size records, and a record cut by
+// a crash is ignored on load. The header holds the format version and the
+// settings the games were played with (everything that decides them
+// besides the key), so results of other settings are never loaded.
+class GameCache {
+ public:
+  struct Key {
+    int16_t wa[6];
+    int16_t wb[6];
+    uint16_t cols;
+    uint16_t rows;
+    uint32_t depth;
+    bool operator == (const Key& o) const;
+  };
+  GameCache();
+  ~GameCache();
+  bool Find(const Key& key, int* winner, int* rounds) const;
+  void Insert(const Key& key, const int winner, const int rounds);
+  size_t Size() const;
+  // Loads the results in path (if it exists) and appends the new results to
+  // it on each Flush. settings identifies the engine and the settings of
+  // the games: a file written with other settings or in another format is
+  // rejected. Returns false if the file could not be used.
+  bool Open(const std::string& path, const uint64_t settings);
+  // Appends the results inserted since the last successful Flush. If the
+  // write fails they are kept for the next one.
+  bool Flush();
+ private:
+  static const size_t kShards = 64;
+  // Reads the records of the open file, past its header.
+  bool Load(const std::string& path);
+  struct KeyHash {
+    size_t operator () (const Key& k) const;
+  };
+  struct Value {
+    int8_t winner;
+    uint16_t rounds;
+  };
+  struct Record {
+    Key key;
+    Value value;
+  };
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<Key, Value, KeyHash> map;
+    // Inserted since the last successful Flush.
+    std::vector<Record> pending;
+  };
+  Shard shards_[kShards];
+  FILE* file_;
+  GameCache(const GameCache&);
+  GameCache& operator = (const GameCache&);
+};
+
+#endif  // GAME_CACHE_HPP_
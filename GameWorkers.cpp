@@ -0,0 +1,358 @@
+#include "GameWorkers.hpp"
+
+#include "Socket.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <glog/logging.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Messages start with a type and a count. A worker says hello with the
+// protocol version as count, followed by its number of threads, and the
+// coordinator answers with a hello with its version. Then the coordinator
+// sends jobs, and the worker answers with one result per job. Bye tells a
+// worker to quit.
+typedef enum {MSG_HELLO = 1, MSG_JOBS = 2, MSG_RESULTS = 3, MSG_BYE = 4}
+  MessageType;
+// Bump whenever the messages change.
+const uint32_t kProtocolVersion = 2;
+// Most jobs (or results) in a message, so that a corrupt count cannot make
+// the reader allocate gigabytes.
+const uint32_t kMaxJobs = 1 << 16;
+
+const size_t kJobSize = sizeof(uint32_t) + 2 * 6 * sizeof(int16_t) +
+    2 * sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint8_t) +
+    sizeof(uint64_t);
+const size_t kResultSize = sizeof(uint32_t) + 2 * sizeof(int32_t);
+// Seconds a worker keeps trying to reach the coordinator.
+const int kConnectRetries = 60;
+
+template <class T>
+inline char* Put(char* p, const T& v) {
+  memcpy(p, &v, sizeof(T));
+  return p + sizeof(T);
+}
+
+template <class T>
+inline const char* Get(const char* p, T* v) {
+  memcpy(v, p, sizeof(T));
+  return p + sizeof(T);
+}
+
+bool WriteHeader(const int fd, const uint32_t type, const uint32_t count) {
+  const uint32_t h[2] = {type, count};
+  return WriteAll(fd, h, sizeof(h));
+}
+
+bool ReadHeader(const int fd, uint32_t* type, uint32_t* count) {
+  uint32_t h[2];
+  if (!ReadAll(fd, h, sizeof(h))) return false;
+  *type = h[0];
+  *count = h[1];
+  return true;
+}
+
+bool WriteJobs(const int fd, const std::vector<GameJob>& jobs) {
+  std::vector<char> buf(jobs.size() * kJobSize);
+  char* p = buf.data();
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const GameJob& j = jobs[i];
+    p = Put(p, j.id);
+    for (int k = 0; k < 6; ++k) { p = Put(p, j.wa[k]); }
+    for (int k = 0; k < 6; ++k) { p = Put(p, j.wb[k]); }
+    p = Put(p, j.cols);
+    p = Put(p, j.rows);
+    p = Put(p, j.depth);
+    p = Put(p, (uint8_t)j.random);
+    p = Put(p, j.seed);
+  }
+  return WriteHeader(fd, MSG_JOBS, jobs.size()) &&
+      WriteAll(fd, buf.data(), buf.size());
+}
+
+bool ReadJobs(const int fd, const uint32_t count, std::vector<GameJob>* jobs) {
+  if (count > kMaxJobs) return false;
+  std::vector<char> buf(count * kJobSize);
+  if (!ReadAll(fd, buf.data(), buf.size())) return false;
+  jobs->resize(count);
+  const char* p = buf.data();
+  for (size_t i = 0; i < count; ++i) {
+    GameJob& j = (*jobs)[i];
+    uint8_t random = 0;
+    p = Get(p, &j.id);
+    for (int k = 0; k < 6; ++k) { p = Get(p, &j.wa[k]); }
+    for (int k = 0; k < 6; ++k) { p = Get(p, &j.wb[k]); }
+    p = Get(p, &j.cols);
+    p = Get(p, &j.rows);
+    p = Get(p, &j.depth);
+    p = Get(p, &random);
+    p = Get(p, &j.seed);
+    j.random = random != 0;
+  }
+  return true;
+}
+
+bool WriteResults(const int fd, const std::vector<GameJobResult>& results) {
+  std::vector<char> buf(results.size() * kResultSize);
+  char* p = buf.data();
+  for (size_t i = 0; i < results.size(); ++i) {
+    p = Put(p, results[i].id);
+    p = Put(p, results[i].winner);
+    p = Put(p, results[i].rounds);
+  }
+  return WriteHeader(fd, MSG_RESULTS, results.size()) &&
+      WriteAll(fd, buf.data(), buf.size());
+}
+
+bool ReadResults(const int fd, const uint32_t count,
+                 std::vector<GameJobResult>* results) {
+  if (count > kMaxJobs) return false;
+  std::vector<char> buf(count * kResultSize);
+  if (!ReadAll(fd, buf.data(), buf.size())) return false;
+  results->resize(count);
+  const char* p = buf.data();
+  for (size_t i = 0; i < count; ++i) {
+    p = Get(p, &(*results)[i].id);
+    p = Get(p, &(*results)[i].winner);
+    p = Get(p, &(*results)[i].rounds);
+  }
+  return true;
+}
+
+// Makes the reads and writes on fd fail after timeout_s seconds without
+// progress.
+void SetTimeout(const int fd, const size_t timeout_s) {
+  struct timeval tv;
+  tv.tv_sec = timeout_s;
+  tv.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+}  // namespace
+
+GameCoordinator::GameCoordinator(const std::string& address,
+                                 const size_t batch_size,
+                                 const size_t batch_timeout_s,
+                                 const size_t worker_wait_s)
+    : batch_size_(std::max<size_t>(batch_size, 1)),
+      batch_timeout_s_(std::max<size_t>(batch_timeout_s, 1)),
+      worker_wait_s_(std::max<size_t>(worker_wait_s, 1)), listen_fd_(-1),
+      results_(NULL), pending_(0), workers_(0), quit_(false) {
+  listen_fd_ = ListenSocket(address);
+  CHECK_GE(listen_fd_, 0) << "Could not listen on \"" << address << "\": "
+                          << strerror(errno);
+  unix_path_ = UnixSocketPath(address);
+  LOG(INFO) << "Waiting for workers at " << address;
+  accept_thread_ = std::thread(&GameCoordinator::Accept, this);
+}
+
+GameCoordinator::~GameCoordinator() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  work_cv_.notify_all();
+  // Wakes up the accept thread.
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.join();
+  close(listen_fd_);
+  for (size_t i = 0; i < worker_threads_.size(); ++i) {
+    worker_threads_[i].join();
+  }
+  if (!unix_path_.empty()) { unlink(unix_path_.c_str()); }
+}
+
+void GameCoordinator::Accept() {
+  for (;;) {
+    const int fd = accept(listen_fd_, NULL, NULL);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (quit_) {
+      if (fd >= 0) { close(fd); }
+      return;
+    }
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      LOG(WARNING) << "Could not accept workers: " << strerror(errno);
+      return;
+    }
+    // Joins the threads of the workers gone (their Serve has returned once
+    // they are in finished_ and the lock is free).
+    for (size_t i = 0; i < finished_.size(); ++i) {
+      for (size_t j = 0; j < worker_threads_.size(); ++j) {
+        if (worker_threads_[j].get_id() != finished_[i]) continue;
+        worker_threads_[j].join();
+        worker_threads_.erase(worker_threads_.begin() + j);
+        break;
+      }
+    }
+    finished_.clear();
+    worker_threads_.push_back(std::thread(&GameCoordinator::Serve, this, fd));
+  }
+}
+
+void GameCoordinator::Serve(const int fd) {
+  ServeWorker(fd);
+  close(fd);
+  std::lock_guard<std::mutex> lock(mutex_);
+  finished_.push_back(std::this_thread::get_id());
+}
+
+void GameCoordinator::ServeWorker(const int fd) {
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  // Bounds the wait for each batch, and for the hello of a connection which
+  // is not a worker.
+  SetTimeout(fd, batch_timeout_s_);
+  uint32_t type = 0, version = 0, threads = 0;
+  if (!ReadHeader(fd, &type, &version) || type != MSG_HELLO) {
+    LOG(WARNING) << "Rejected a connection which is not a worker";
+    return;
+  }
+  if (version != kProtocolVersion || !ReadAll(fd, &threads, sizeof(threads))) {
+    LOG(WARNING) << "Rejected a worker speaking protocol version " << version
+                 << " instead of " << kProtocolVersion;
+    WriteHeader(fd, MSG_HELLO, kProtocolVersion);
+    return;
+  }
+  if (!WriteHeader(fd, MSG_HELLO, kProtocolVersion)) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++workers_;
+    LOG(INFO) << "Worker connected (" << threads << " threads). Workers = "
+              << workers_;
+  }
+  done_cv_.notify_all();
+  // Enough jobs to keep all the threads of the worker busy.
+  const size_t batch = std::min<size_t>(
+      batch_size_ * std::max<uint32_t>(threads, 1), kMaxJobs);
+  std::vector<GameJob> jobs;
+  std::vector<GameJobResult> results;
+  for (;;) {
+    jobs.clear();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+      if (quit_) break;
+      while (!queue_.empty() && jobs.size() < batch) {
+        jobs.push_back(queue_.front());
+        queue_.pop_front();
+      }
+    }
+    uint32_t count = 0;
+    errno = 0;
+    if (!WriteJobs(fd, jobs) || !ReadHeader(fd, &type, &count) ||
+        type != MSG_RESULTS || count != jobs.size() ||
+        !ReadResults(fd, count, &results)) {
+      const bool timeout = (errno == EAGAIN || errno == EWOULDBLOCK);
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.insert(queue_.begin(), jobs.begin(), jobs.end());
+      --workers_;
+      LOG(WARNING) << (timeout ? "A worker timed out" : "Lost a worker")
+                   << ", retrying its " << jobs.size() << " games. Workers = "
+                   << workers_;
+      work_cv_.notify_all();
+      done_cv_.notify_all();
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < results.size(); ++i) {
+      const uint32_t id = results[i].id;
+      if (results_ == NULL || id >= done_.size() || done_[id]) continue;
+      (*results_)[id] = results[i];
+      done_[id] = true;
+      --pending_;
+    }
+    if (pending_ == 0) { done_cv_.notify_all(); }
+  }
+  WriteHeader(fd, MSG_BYE, 0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  --workers_;
+}
+
+bool GameCoordinator::Run(const std::vector<GameJob>& jobs,
+                          std::vector<GameJobResult>* results) {
+  CHECK_NOTNULL(results);
+  results->resize(jobs.size());
+  if (jobs.empty()) return true;
+  std::unique_lock<std::mutex> lock(mutex_);
+  results_ = results;
+  done_.assign(jobs.size(), false);
+  pending_ = jobs.size();
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    queue_.push_back(jobs[i]);
+    queue_.back().id = i;
+  }
+  if (workers_ == 0) { LOG(WARNING) << "No workers connected yet"; }
+  work_cv_.notify_all();
+  // Waits for the results, giving up if no worker is connected for
+  // worker_wait_s_ seconds.
+  while (pending_ > 0) {
+    if (workers_ > 0) {
+      done_cv_.wait(lock, [this]() { return pending_ == 0 || workers_ == 0; });
+      continue;
+    }
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::seconds(worker_wait_s_);
+    if (!done_cv_.wait_until(lock, deadline, [this]() {
+          return pending_ == 0 || workers_ > 0; })) {
+      LOG(WARNING) << "No workers connected for " << worker_wait_s_
+                   << " sec. with " << pending_ << " games left";
+      queue_.clear();
+      results_ = NULL;
+      return false;
+    }
+  }
+  results_ = NULL;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    (*results)[i].id = jobs[i].id;
+  }
+  return true;
+}
+
+void RunGameWorker(const std::string& address, const size_t num_threads,
+                   const GamePlayer& play) {
+  int fd = -1;
+  for (int i = 0; i < kConnectRetries && fd < 0; ++i) {
+    if (i > 0) { std::this_thread::sleep_for(std::chrono::seconds(1)); }
+    fd = ConnectSocket(address);
+  }
+  CHECK_GE(fd, 0) << "Could not connect to the coordinator at \"" << address
+                  << "\"";
+  WorkStealingPool pool(num_threads);
+  const uint32_t threads = pool.Size();
+  uint32_t type = 0, count = 0;
+  CHECK(WriteHeader(fd, MSG_HELLO, kProtocolVersion) &&
+        WriteAll(fd, &threads, sizeof(threads)) &&
+        ReadHeader(fd, &type, &count))
+      << "Lost the connection to the coordinator at \"" << address << "\"";
+  CHECK(type == MSG_HELLO && count == kProtocolVersion)
+      << "The coordinator at \"" << address << "\" speaks protocol version "
+      << count << " instead of " << kProtocolVersion;
+  LOG(INFO) << "Connected to the coordinator at " << address;
+  std::vector<GameJob> jobs;
+  std::vector<GameJobResult> results;
+  while (ReadHeader(fd, &type, &count) && type == MSG_JOBS &&
+         ReadJobs(fd, count, &jobs)) {
+    results.resize(jobs.size());
+    pool.Run(jobs.size(), [&](const size_t i) {
+        play(jobs[i], &results[i]);
+        results[i].id = jobs[i].id;
+      });
+    if (!WriteResults(fd, results)) break;
+  }
+  if (type != MSG_BYE) {
+    LOG(WARNING) << "Lost the connection to the coordinator";
+  }
+  close(fd);
+}
@@ -0,0 +1,85 @@
+#ifndef GAME_WORKERS_HPP_
+#define GAME_WORKERS_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A game between two weight heuristics, with everything a worker needs to
+// play it exactly as the coordinator would.
+struct GameJob {
+  uint32_t id;
+  int16_t wa[6];
+  int16_t wb[6];
+  uint16_t cols;
+  uint16_t rows;
+  uint32_t depth;
+  bool random;
+  uint64_t seed;
+};
+
+struct GameJobResult {
+  uint32_t id;
+  int32_t winner;
+  int32_t rounds;
+};
+
+typedef std::function<void(const GameJob&, GameJobResult*)> GamePlayer;
+
+// Coordinator side of the distributed evaluation: listens on an address
+// (host:port for TCP, or unix:path for a Unix socket) for workers started
+// with RunGameWorker. Run splits its jobs in batches of batch_size and sends
+// each batch to an idle worker. Workers may join at any time. If a worker
+// is lost, or does not answer a batch within batch_timeout_s, its batch
+// goes back to the queue and is sent to another one.
+class GameCoordinator {
+ public:
+  GameCoordinator(const std::string& address, const size_t batch_size,
+                  const size_t batch_timeout_s, const size_t worker_wait_s);
+  // Tells the connected workers to quit.
+  ~GameCoordinator();
+  // Plays the jobs on the workers and waits for all the results, which are
+  // returned in the order of the jobs. Returns false if no worker was
+  // connected for worker_wait_s while games were left.
+  bool Run(const std::vector<GameJob>& jobs,
+           std::vector<GameJobResult>* results);
+ private:
+  const size_t batch_size_;
+  const size_t batch_timeout_s_;
+  const size_t worker_wait_s_;
+  int listen_fd_;
+  std::string unix_path_;
+  std::thread accept_thread_;
+  std::vector<std::thread> worker_threads_;
+  // Threads of the workers gone, joined by the accept thread.
+  std::vector<std::thread::id> finished_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::deque<GameJob> queue_;
+  std::vector<GameJobResult>* results_;
+  std::vector<bool> done_;
+  size_t pending_;
+  size_t workers_;
+  bool quit_;
+  void Accept();
+  void Serve(const int fd);
+  // Plays batches on the worker at fd until it is lost or told to quit.
+  void ServeWorker(const int fd);
+  GameCoordinator(const GameCoordinator&);
+  GameCoordinator& operator = (const GameCoordinator&);
+};
+
+// Worker side: connects to the coordinator at address and plays the jobs it
+// receives with play, on num_threads threads, until the coordinator tells it
+// to quit or goes away.
+void RunGameWorker(const std::string& address, const size_t num_threads,
+                   const GamePlayer& play);
+
+#endif  // GAME_WORKERS_HPP_
@@ -1,6 +1,27 @@
 #include "Heuristic.hpp"
+#include "Evaluator.hpp"
+#include "WindowTable.hpp"
 
+#include <glog/logging.h>
+#include <string.h>
+#include <algorithm>
 #include <cmath>
+#include <vector>
+
+namespace {
+
+// Bitwise comparison, so that NaN scores compare equal.
+inline bool SameScore(const float a, const float b) {
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+}  // namespace
+
+Evaluator* SimpleHeuristic::NewEvaluator(
+    const uint16_t cols, const uint16_t rows, const uint8_t pa,
+    const uint8_t pb) const {
+  return new SimpleEvaluator();
+}
 
 float SimpleHeuristic::LineHeuristic(
     const uint8_t line[4], const uint8_t pa, const uint8_t pb) const {
@@ -47,6 +68,13 @@ float SimpleHeuristic::operator () (
   return 0.0f;
 }
 
+float SimpleHeuristic::operator () (
+    const BitBoard& b, const uint8_t pa, const uint8_t pb) const {
+  if (b.Connected(pa)) return +INFINITY;
+  if (b.Connected(pb)) return -INFINITY;
+  return 0.0f;
+}
+
 WeightHeuristic::WeightHeuristic(const float weights[6]) {
   weights_[0] = weights[0];
   weights_[1] = weights[1];
@@ -54,6 +82,20 @@ WeightHeuristic::WeightHeuristic(const float weights[6]) {
   weights_[3] = weights[3];
   weights_[4] = weights[4];
   weights_[5] = weights[5];
+  // Precompute the score of each window pattern.
+  for (uint8_t a = 0; a <= 4; ++a) {
+    for (uint8_t b = 0; a + b <= 4; ++b) {
+      uint8_t line[4] = {' ', ' ', ' ', ' '};
+      for (uint8_t i = 0; i < a + b; ++i) { line[i] = i < a ? 'A' : 'B'; }
+      pattern_[5 * a + b] = LineHeuristic(line, 'A', 'B');
+    }
+  }
+}
+
+Evaluator* WeightHeuristic::NewEvaluator(
+    const uint16_t cols, const uint16_t rows, const uint8_t pa,
+    const uint8_t pb) const {
+  return new WeightEvaluator(weights_, cols, rows, pa, pb);
 }
 
 float WeightHeuristic::LineHeuristic(
@@ -77,8 +119,9 @@ float WeightHeuristic::LineHeuristic(
   return 0.0f;
 }
 
-float WeightHeuristic::operator () (
-    const Board& b, const uint8_t pa, const uint8_t pb) const {
+template <class B>
+float WeightHeuristic::ReferenceScore(
+    const B& b, const uint8_t pa, const uint8_t pb) const {
   float score = 0.0f;
   for (uint16_t c = 0; c < b.Cols(); ++c) {
     for (uint16_t r = 0; r < b.Rows(); ++r) {
@@ -107,3 +150,54 @@ float WeightHeuristic::operator () (
   return score;
 }
 
+template float WeightHeuristic::ReferenceScore(
+    const Board& b, const uint8_t pa, const uint8_t pb) const;
+template float WeightHeuristic::ReferenceScore(
+    const BitBoard& b, const uint8_t pa, const uint8_t pb) const;
+
+// The table-driven versions add the window scores in the same order as
+// ReferenceScore(), so the results are bit-identical to it (which is
+// checked in debug builds and by connect4_check).
+float WeightHeuristic::operator () (
+    const Board& b, const uint8_t pa, const uint8_t pb) const {
+  return Score(b, pa, pb, BestWindowKernel());
+}
+
+float WeightHeuristic::Score(const Board& b, const uint8_t pa,
+                             const uint8_t pb,
+                             const WindowKernel kernel) const {
+  const WindowTable& t = WindowTable::Get(b.Cols(), b.Rows());
+  // The SIMD kernels may read up to 3 bytes past the last cell.
+  const size_t ncells = b.Cols() * b.Rows();
+  static thread_local std::vector<uint8_t> cells;
+  if (cells.size() < ncells + 3) { cells.resize(ncells + 3); }
+  memcpy(cells.data(), b.Data(), ncells);
+  float score = 0.0f;
+  uint8_t patterns[64];
+  for (size_t w = 0; w < t.Size(); w += 64) {
+    const size_t end = std::min(w + 64, t.Size());
+    ComputeWindowPatterns(t, cells.data(), pa, pb, w, end, patterns, kernel);
+    for (size_t i = 0; i < end - w; ++i) {
+      score += pattern_[patterns[i]];
+    }
+  }
+  DCHECK(SameScore(score, ReferenceScore(b, pa, pb)));
+  return score;
+}
+
+float WeightHeuristic::operator () (
+    const BitBoard& b, const uint8_t pa, const uint8_t pb) const {
+  const WindowTable& t = WindowTable::Get(b.Cols(), b.Rows());
+  const uint64_t da = b.Discs(pa), db = b.Discs(pb);
+  float score = 0.0f;
+  uint8_t patterns[64];
+  for (size_t w = 0; w < t.Size(); w += 64) {
+    const size_t end = std::min(w + 64, t.Size());
+    ComputeWindowPatterns(t, da, db, w, end, patterns);
+    for (size_t i = 0; i < end - w; ++i) {
+      score += pattern_[patterns[i]];
+    }
+  }
+  DCHECK(SameScore(score, ReferenceScore(b, pa, pb)));
+  return score;
+}
@@ -1,29 +1,61 @@
 #ifndef HEURISTIC_HPP_
 #define HEURISTIC_HPP_
 
+#include "BitBoard.hpp"
 #include "Board.hpp"
+#include "WindowTable.hpp"
 
 #include <stdint.h>
 
+class Evaluator;
+
 class Heuristic {
  public:
+  // Returns a new incremental evaluator for this heuristic, or NULL if the
+  // heuristic does not have one. The evaluator tracks the discs of players
+  // pa and pb on a board of the given size.
+  virtual Evaluator* NewEvaluator(const uint16_t cols, const uint16_t rows,
+                                  const uint8_t pa, const uint8_t pb) const {
+    return NULL;
+  }
   virtual float operator () (const Board& b, const uint8_t pa, const uint8_t pb) const = 0;
+  virtual float operator () (const BitBoard& b, const uint8_t pa, const uint8_t pb) const = 0;
 };
 
-class SimpleHeuristic : public Heuristic {
+// The concrete heuristics are final, so that searches templated on them
+// call them directly instead of through the vtable.
+class SimpleHeuristic final : public Heuristic {
  public:
+  virtual Evaluator* NewEvaluator(const uint16_t cols, const uint16_t rows,
+                                  const uint8_t pa, const uint8_t pb) const;
   virtual float operator () (const Board& b, const uint8_t pa, const uint8_t pb) const;
+  virtual float operator () (const BitBoard& b, const uint8_t pa, const uint8_t pb) const;
  private:
   virtual float LineHeuristic(const uint8_t line[4], const uint8_t pa, const uint8_t pb) const;
 };
 
-class WeightHeuristic : public Heuristic {
+class WeightHeuristic final : public Heuristic {
  public:
   WeightHeuristic(const float weights[6]);
+  inline const float* Weights() const { return weights_; }
+  virtual Evaluator* NewEvaluator(const uint16_t cols, const uint16_t rows,
+                                  const uint8_t pa, const uint8_t pb) const;
   virtual float operator () (const Board& b, const uint8_t pa, const uint8_t pb) const;
+  virtual float operator () (const BitBoard& b, const uint8_t pa, const uint8_t pb) const;
+  // Table-driven score of the board with the given kernel. The Board
+  // operator uses the best one.
+  float Score(const Board& b, const uint8_t pa, const uint8_t pb,
+              const WindowKernel kernel) const;
+  // Reference implementation: scans the board with LineHeuristic. The
+  // table-driven scores must be bit-identical to it (see connect4_check).
+  template <class B>
+  float ReferenceScore(const B& b, const uint8_t pa, const uint8_t pb) const;
  private:
   virtual float LineHeuristic(const uint8_t line[4], const uint8_t pa, const uint8_t pb) const;
   float weights_[6];
+  // LineHeuristic of a window with a discs of pa and b discs of pb, at
+  // pattern_[5 * a + b].
+  float pattern_[25];
 };
 
 #endif
@@ -0,0 +1,243 @@
+#include "MCTS.hpp"
+
+#include "BitBoard.hpp"
+#include "Board.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+MCTS::MCTS(const size_t tree_size_mb, const size_t num_threads,
+           const bool root_parallel, const float exploration)
+    : num_threads_(std::max<size_t>(num_threads, 1)),
+      root_parallel_(root_parallel), exploration_(exploration),
+      capacity_(std::min<size_t>(
+          std::max<size_t>((tree_size_mb << 20) / sizeof(Node), 2),
+          kNoChildren)),
+      nodes_(new Node[capacity_]), used_(1), playouts_(0), stop_(false) {}
+
+MCTS::~MCTS() {
+  delete [] nodes_;
+}
+
+uint32_t MCTS::NewNode(const uint16_t move, const uint8_t end) {
+  const size_t i = used_++;
+  CHECK_LT(i, capacity_);
+  Node& n = nodes_[i];
+  n.visits.store(0, std::memory_order_relaxed);
+  n.score.store(0, std::memory_order_relaxed);
+  n.children.store(0, std::memory_order_relaxed);
+  n.num_children = 0;
+  n.move = move;
+  n.end = end;
+  return i;
+}
+
+// Creates the children of the node, where player p is to move and there
+// are empty cells left. Only one thread expands each node: the others see
+// it as a leaf meanwhile. Returns false if another thread expands it, or
+// the arena is full.
+template <class B>
+bool MCTS::Expand(B* board, const uint8_t p, const size_t empty,
+                  Node* node) {
+  uint32_t expected = 0;
+  if (!node->children.compare_exchange_strong(expected, kNoChildren)) {
+    return false;
+  }
+  uint16_t k = 0;
+  for (uint16_t c = 0; c < board->Cols(); ++c) {
+    if (board->Height(c) < board->Rows()) ++k;
+  }
+  const size_t first = used_.fetch_add(k);
+  if (first + k > capacity_) return false;
+  Node* child = nodes_ + first;
+  for (uint16_t c = 0; c < board->Cols(); ++c) {
+    if (board->Height(c) >= board->Rows()) continue;
+    board->Move(c, p);
+    child->visits.store(0, std::memory_order_relaxed);
+    child->score.store(0, std::memory_order_relaxed);
+    child->children.store(0, std::memory_order_relaxed);
+    child->num_children = 0;
+    child->move = c;
+    child->end = board->WinsAt(c) ? kWin : (empty == 1 ? kDraw : 0);
+    board->Undo(c);
+    ++child;
+  }
+  node->num_children = k;
+  node->children.store(first, std::memory_order_release);
+  return true;
+}
+
+template <class B>
+void MCTS::Worker(const B& board, const uint8_t pa, const uint8_t pb,
+                  const uint32_t root, const size_t playouts,
+                  const bool timed,
+                  const std::chrono::steady_clock::time_point& deadline,
+                  const uint64_t seed) {
+  B b(board);
+  const uint16_t rows = b.Rows();
+  size_t empty0 = b.Cols() * rows;
+  for (uint16_t c = 0; c < b.Cols(); ++c) { empty0 -= b.Height(c); }
+  const uint8_t ids[2] = {pa, pb};
+  std::default_random_engine rng(seed);
+  // Nodes of the current path and moves played, to undo them afterwards.
+  std::vector<uint32_t> path(empty0 + 1);
+  std::vector<uint16_t> played(empty0);
+  std::vector<uint16_t> open(b.Cols());
+  for (size_t it = 0; !stop_.load(std::memory_order_relaxed); ++it) {
+    // Reading the clock is not free, check it every 64 playouts only.
+    if (timed && (it & 0x3F) == 0 &&
+        std::chrono::steady_clock::now() >= deadline) {
+      stop_ = true;
+      break;
+    }
+    if (playouts_.fetch_add(1, std::memory_order_relaxed) >= playouts &&
+        !timed) {
+      stop_ = true;
+      break;
+    }
+    size_t depth = 0, n = 0, empty = empty0;
+    int side = 0;
+    // Result for the player who moved into the last node of the path: 2
+    // for a win, 1 for a draw and 0 for a loss.
+    uint32_t r = 1;
+    for (uint32_t i = root;;) {
+      Node* node = nodes_ + i;
+      path[depth++] = i;
+      const uint32_t visits =
+          node->visits.fetch_add(1, std::memory_order_relaxed) + 1;
+      if (node->end != 0) {
+        r = (node->end == kWin ? 2 : 1);
+        break;
+      }
+      uint32_t first = node->children.load(std::memory_order_acquire);
+      if (first == 0 && visits > 1 &&
+          Expand(&b, ids[side], empty, node)) {
+        first = node->children.load(std::memory_order_acquire);
+      }
+      if (first == 0 || first == kNoChildren) {
+        // Random playout.
+        size_t num_open = 0;
+        for (uint16_t c = 0; c < b.Cols(); ++c) {
+          if (b.Height(c) < rows) { open[num_open++] = c; }
+        }
+        for (int s = side; empty > 0; s ^= 1) {
+          const size_t j = rng() % num_open;
+          const uint16_t c = open[j];
+          b.Move(c, ids[s]);
+          played[n++] = c;
+          --empty;
+          if (b.WinsAt(c)) {
+            r = (s == side ? 0 : 2);
+            break;
+          }
+          if (b.Height(c) == rows) { open[j] = open[--num_open]; }
+        }
+        break;
+      }
+      // UCT, counting the visits of the other threads still on their way.
+      const float log_visits = std::log((float)visits);
+      const uint16_t k = node->num_children;
+      const uint16_t offset = rng() % k;
+      uint32_t best = first + offset;
+      float best_uct = -INFINITY;
+      for (uint16_t j = 0; j < k; ++j) {
+        const uint32_t c = first + (j + offset) % k;
+        const uint32_t cv = nodes_[c].visits.load(std::memory_order_relaxed);
+        if (cv == 0) {
+          best = c;
+          break;
+        }
+        const float uct =
+            nodes_[c].score.load(std::memory_order_relaxed) / (2.0f * cv) +
+            exploration_ * std::sqrt(log_visits / cv);
+        if (uct > best_uct) {
+          best_uct = uct;
+          best = c;
+        }
+      }
+      b.Move(nodes_[best].move, ids[side]);
+      played[n++] = nodes_[best].move;
+      --empty;
+      side ^= 1;
+      i = best;
+    }
+    for (size_t i = depth; i-- > 0; r = 2 - r) {
+      nodes_[path[i]].score.fetch_add(r, std::memory_order_relaxed);
+    }
+    while (n > 0) { b.Undo(played[--n]); }
+  }
+}
+
+template <class B>
+MCTS::Result MCTS::Search(
+    const B& board, const uint8_t pa, const uint8_t pb,
+    const size_t playouts, const bool timed,
+    const std::chrono::steady_clock::time_point& deadline,
+    std::default_random_engine* rng) {
+  CHECK_NOTNULL(rng);
+  Result res = {(uint32_t)~0, 0.5f, 0, 0};
+  size_t empty = board.Cols() * board.Rows();
+  for (uint16_t c = 0; c < board.Cols(); ++c) { empty -= board.Height(c); }
+  if (empty == 0) return res;
+  // Node 0 is never used, so that 0 can stand for no children.
+  used_ = 1;
+  playouts_ = 0;
+  stop_ = false;
+  B b(board);
+  std::vector<uint32_t> roots(root_parallel_ ? num_threads_ : 1);
+  for (size_t i = 0; i < roots.size(); ++i) {
+    roots[i] = NewNode(~0, 0);
+    CHECK(Expand(&b, pa, empty, &nodes_[roots[i]]))
+        << "The tree does not fit the root moves";
+  }
+  const Node& root = nodes_[roots[0]];
+  const uint32_t first = root.children.load(std::memory_order_relaxed);
+  // A single move needs no search.
+  if (root.num_children == 1) {
+    res.move = nodes_[first].move;
+    res.nodes = used_ - 1;
+    return res;
+  }
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads_; ++i) {
+    threads.push_back(std::thread(
+        &MCTS::Worker<B>, this, std::cref(board), pa, pb,
+        roots[root_parallel_ ? i : 0], playouts, timed, std::cref(deadline),
+        (uint64_t)(*rng)()));
+  }
+  Worker(board, pa, pb, roots[0], playouts, timed, deadline, (*rng)());
+  for (size_t i = 0; i < threads.size(); ++i) { threads[i].join(); }
+  // The roots have the same moves in the same order.
+  uint64_t best_visits = 0;
+  for (uint16_t j = 0; j < root.num_children; ++j) {
+    uint64_t visits = 0, score = 0;
+    for (size_t i = 0; i < roots.size(); ++i) {
+      const Node& c = nodes_[nodes_[roots[i]].children + j];
+      visits += c.visits;
+      score += c.score;
+    }
+    if (visits > best_visits || res.move == (uint32_t)~0) {
+      best_visits = visits;
+      res.move = nodes_[first + j].move;
+      res.value = (visits > 0 ? score / (2.0f * visits) : 0.5f);
+    }
+  }
+  res.playouts = (timed ? playouts_.load() :
+                  std::min<size_t>(playouts_, playouts));
+  res.nodes = std::min<size_t>(used_, capacity_) - 1;
+  return res;
+}
+
+#define INSTANTIATE_MCTS(B)                                            \
+  template MCTS::Result MCTS::Search<B>(                               \
+      const B&, const uint8_t, const uint8_t, const size_t,            \
+      const bool, const std::chrono::steady_clock::time_point&,        \
+      std::default_random_engine*);
+
+INSTANTIATE_MCTS(Board)
+INSTANTIATE_MCTS(BitBoard)
+INSTANTIATE_MCTS(BitBoard7x6)
+INSTANTIATE_MCTS(BitBoard8x7)
@@ -0,0 +1,81 @@
+#ifndef MCTS_HPP_
+#define MCTS_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+
+// Monte Carlo Tree Search with the UCT selection rule and uniformly random
+// playouts. The nodes live in an arena allocated once, and the playouts
+// play and undo the moves on a copy of the board per thread, so searching
+// does not allocate memory. Several threads either share a single tree
+// (tree parallelism, with a virtual loss: a visit is counted on the way
+// down and its result added on the way back, so the other threads avoid
+// the paths being explored), or build a tree each and add up the visits of
+// the root moves (root parallelism). When the arena is full, the search
+// goes on without growing the trees.
+class MCTS {
+ public:
+  struct Result {
+    // Most visited root move, or ~0 if the game is over.
+    uint32_t move;
+    // Expected score of the move for the player to move, from 0 (loss) to
+    // 1 (win).
+    float value;
+    size_t playouts;
+    size_t nodes;
+  };
+  MCTS(const size_t tree_size_mb, const size_t num_threads,
+       const bool root_parallel, const float exploration = 1.4f);
+  ~MCTS();
+  // Searches the board for player pa, who is to move, against player pb,
+  // until the given number of playouts is reached or, if timed is set,
+  // until the deadline. rng seeds the random engines of the threads.
+  // Works on the same board representations as the Negamax searches.
+  template <class B>
+  Result Search(const B& board, const uint8_t pa, const uint8_t pb,
+                const size_t playouts, const bool timed,
+                const std::chrono::steady_clock::time_point& deadline,
+                std::default_random_engine* rng);
+  inline size_t Capacity() const { return capacity_; }
+ private:
+  struct Node {
+    std::atomic<uint32_t> visits;
+    // Two points per win and one per draw, for the player who moved into
+    // the node.
+    std::atomic<uint32_t> score;
+    // Index of the first child in the arena, 0 if the node is a leaf, or
+    // kNoChildren while it is being expanded or if it cannot be.
+    std::atomic<uint32_t> children;
+    uint16_t num_children;
+    uint16_t move;
+    // The game ends with the move into the node: kWin or kDraw.
+    uint8_t end;
+  };
+  static const uint32_t kNoChildren = ~UINT32_C(0);
+  static const uint8_t kWin = 1;
+  static const uint8_t kDraw = 2;
+  const size_t num_threads_;
+  const bool root_parallel_;
+  const float exploration_;
+  size_t capacity_;
+  Node* nodes_;
+  std::atomic<size_t> used_;
+  std::atomic<size_t> playouts_;
+  std::atomic<bool> stop_;
+  uint32_t NewNode(const uint16_t move, const uint8_t end);
+  template <class B>
+  bool Expand(B* board, const uint8_t p, const size_t empty, Node* node);
+  template <class B>
+  void Worker(const B& board, const uint8_t pa, const uint8_t pb,
+              const uint32_t root, const size_t playouts, const bool timed,
+              const std::chrono::steady_clock::time_point& deadline,
+              const uint64_t seed);
+  MCTS(const MCTS&);
+  MCTS& operator = (const MCTS&);
+};
+
+#endif  // MCTS_HPP_
@@ -0,0 +1,51 @@
+#include "MoveOrdering.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+MoveOrdering::MoveOrdering(const uint16_t cols, const uint16_t rows)
+    : cols_(cols), rows_(rows), center_(cols), keys_(cols) {
+  history_[0].resize(cols_ * rows_, 0);
+  history_[1].resize(cols_ * rows_, 0);
+  // Closeness to the center: higher is better.
+  for (uint16_t c = 0; c < cols_; ++c) {
+    center_[c] = cols_ - std::abs(2 * c - (cols_ - 1));
+  }
+}
+
+uint64_t MoveOrdering::Key(const size_t ply, const uint32_t move,
+                           const uint16_t row,
+                           const uint32_t hash_move) const {
+  uint64_t cls = 0;
+  if (move == hash_move) { cls = 3; }
+  else if (move == killers_[2 * ply]) { cls = 2; }
+  else if (move == killers_[2 * ply + 1]) { cls = 1; }
+  const uint32_t hist = row < rows_ ? history_[ply & 1][move + row * cols_] : 0;
+  return (cls << 56) | (uint64_t(hist) << 16) | center_[move];
+}
+
+void MoveOrdering::Sort(const bool shuffle, std::default_random_engine& rng,
+                        uint32_t* moves, const size_t n) const {
+  if (shuffle) {
+    std::shuffle(moves, moves + n, rng);
+  }
+  // Stable insertion sort, the lists are short.
+  for (size_t i = 1; i < n; ++i) {
+    const uint32_t m = moves[i];
+    size_t j = i;
+    for (; j > 0 && keys_[moves[j - 1]] < keys_[m]; --j) {
+      moves[j] = moves[j - 1];
+    }
+    moves[j] = m;
+  }
+}
+
+void MoveOrdering::NewSearch() {
+  std::fill(killers_.begin(), killers_.end(), ~0);
+  for (int s = 0; s < 2; ++s) {
+    for (size_t i = 0; i < history_[s].size(); ++i) {
+      history_[s][i] >>= 1;
+    }
+  }
+}
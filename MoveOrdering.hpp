@@ -0,0 +1,61 @@
+#ifndef MOVE_ORDERING_HPP_
+#define MOVE_ORDERING_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Move ordering stage for NegamaxAlphaBeta. Moves are sorted (best first) by
+// the following criteria:
+//  1. The move suggested by the transposition table (or by a previous
+//     iteration).
+//  2. The two killer moves of the ply: the last moves that caused a beta
+//     cutoff at the same distance from the root.
+//  3. The history score of the cell where the disc would land, which
+//     accumulates depth^2 on every cutoff and persists across searches.
+//  4. The distance to the center column (center columns first).
+// Moves equally ranked keep their column order, or a random one (drawn from
+// rng) if shuffle is set.
+class MoveOrdering {
+ public:
+  MoveOrdering(const uint16_t cols, const uint16_t rows);
+  template <class B>
+  void Order(const B& board, const size_t ply, const uint32_t hash_move,
+             const bool shuffle, std::default_random_engine& rng,
+             uint32_t* moves, const size_t n) {
+    if (killers_.size() < 2 * (ply + 1)) { killers_.resize(2 * (ply + 1), ~0); }
+    for (size_t i = 0; i < n; ++i) {
+      keys_[moves[i]] = Key(ply, moves[i], board.Height(moves[i]), hash_move);
+    }
+    Sort(shuffle, rng, moves, n);
+  }
+  // Must be called with the board as it was before the move.
+  template <class B>
+  void Cutoff(const B& board, const size_t ply, const uint32_t move,
+              const size_t depth) {
+    uint32_t* k = &killers_[2 * ply];
+    if (k[0] != move) { k[1] = k[0]; k[0] = move; }
+    uint32_t& h = history_[ply & 1][move + board.Height(move) * cols_];
+    h = std::min<uint32_t>(h + depth * depth, kMaxHistory);
+  }
+  // Forgets the killer moves and ages the history scores.
+  void NewSearch();
+ private:
+  static const uint32_t kMaxHistory = 0xFFFFFF;
+  const uint16_t cols_;
+  const uint16_t rows_;
+  std::vector<uint32_t> killers_;
+  // History scores of each cell, for the player to move at even and odd
+  // plies.
+  std::vector<uint32_t> history_[2];
+  std::vector<uint16_t> center_;
+  std::vector<uint64_t> keys_;
+  uint64_t Key(const size_t ply, const uint32_t move, const uint16_t row,
+               const uint32_t hash_move) const;
+  void Sort(const bool shuffle, std::default_random_engine& rng,
+            uint32_t* moves, const size_t n) const;
+};
+
+#endif  // MOVE_ORDERING_HPP_
@@ -1,61 +1,445 @@
 #include "Negamax.hpp"
 
+#include <glog/logging.h>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 #include <random>
+#include <thread>
+#include <vector>
 
 extern std::default_random_engine PRNG;
 
-std::pair<float, uint32_t> Negamax(
-    const Board& board, const uint8_t pa, const uint8_t pb, const size_t depth,
-    const Heuristic& h, const bool shuffle, size_t* nodes) {
+namespace {
+
+// Legal moves of the board in column order. Returns the number of moves.
+template <class B>
+size_t LegalMoves(const B& board, uint32_t* moves) {
+  size_t n = 0;
+  for (uint16_t col = 0; col < board.Cols(); ++col) {
+    if (board.Height(col) < board.Rows()) { moves[n++] = col; }
+  }
+  return n;
+}
+
+// Whether the move just played at the column won the game. The won
+// position is not searched but it is still counted as a node. Wins are
+// detected here, through the last disc only, so the searches never play
+// past a won position.
+template <class B, class S>
+inline bool WinsAt(const B& board, const uint32_t move, size_t* nodes,
+                   S* stats, const size_t ply) {
+  if (!board.WinsAt(move)) return false;
+  if (nodes != NULL) { ++(*nodes); }
+  stats->Node(ply);
+  stats->Leaf();
+  return true;
+}
+
+// Both searches play and undo the moves on a single board. moves points to
+// a scratch buffer with room for board->Cols() moves per remaining ply.
+// They count into stats, a SearchStats or a NoSearchStats.
+template <class B, class H, class S>
+std::pair<float, uint32_t> NegamaxRec(
+    B* board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, std::default_random_engine& rng,
+    uint32_t* moves, size_t* nodes, S* stats, const size_t ply) {
   if (nodes != NULL) { ++(*nodes); }
-  float v = h(board, pa, pb);
+  stats->Node(ply);
+  float v = h(*board, pa, pb);
   if (std::isfinite(v) == false || depth == 0) {
+    stats->Leaf();
     return std::pair<float,uint32_t>(v, ~0);
   }
-  std::vector<std::pair<uint32_t, Board> > ch_board =
-      board.Expand(pa);
-  if (ch_board.size() == 0) {
+  const size_t n = LegalMoves(*board, moves);
+  if (n == 0) {
+    stats->Leaf();
     return std::pair<float,uint32_t>(v, ~0);
   }
   if (shuffle) {
-    std::shuffle(ch_board.begin(), ch_board.end(), PRNG);
+    std::shuffle(moves, moves + n, rng);
   }
-  uint32_t m = ch_board.front().first;
+  uint32_t m = moves[0];
   v = -INFINITY;
-  for (const auto& chb : ch_board) {
-    const float sc = -(Negamax(
-        chb.second, pb, pa, depth - 1, h, shuffle, nodes).first);
-    if (sc > v) { v = sc; m = chb.first; }
+  for (size_t i = 0; i < n; ++i) {
+    board->Move(moves[i], pa);
+    const float sc = WinsAt(*board, moves[i], nodes, stats, ply + 1) ?
+        +INFINITY :
+        -(NegamaxRec(board, pb, pa, depth - 1, h, shuffle, rng, moves + n,
+                     nodes, stats, ply + 1).first);
+    board->Undo(moves[i]);
+    if (sc > v) { v = sc; m = moves[i]; }
   }
   return std::pair<float,uint32_t>(v, m);
 }
 
-std::pair<float, uint32_t> NegamaxAlphaBeta(
-    const Board& board, const uint8_t pa, const uint8_t pb, const size_t depth,
-    const Heuristic& h, const bool shuffle, float alpha, float beta, size_t* nodes) {
+// The move of the mirror image of the board if mirrored is set, the move
+// itself otherwise. ~0 (no move) is kept.
+template <class B>
+inline uint32_t MirrorMove(const B& board, const bool mirrored,
+                           const uint32_t move) {
+  if (!mirrored || move >= board.Cols()) return move;
+  return board.Cols() - 1 - move;
+}
+
+// Moves the given move (if present) to the front, keeping the order of the
+// others.
+void MoveToFront(uint32_t* moves, const size_t n, const uint32_t m) {
+  uint32_t* it = std::find(moves, moves + n, m);
+  if (it != moves + n) { std::rotate(moves, it, it + 1); }
+}
+
+template <class B, class H, class S>
+std::pair<float, uint32_t> NegamaxAlphaBetaRec(
+    B* board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, float alpha, float beta,
+    uint32_t* moves, size_t* nodes, SearchContext* ctx, S* stats,
+    const uint32_t hint, const size_t ply) {
   if (nodes != NULL) { ++(*nodes); }
-  float v = h(board, pa, pb);
+  stats->Node(ply);
+  if (ctx != NULL && ctx->Aborted()) {
+    return std::pair<float,uint32_t>(0.0f, ~0);
+  }
+  TranspositionTable* tt = (ctx != NULL ? ctx->tt : NULL);
+  // Stored scores are only reused for the same remaining depth, since the
+  // heuristic scores of different depths are not comparable. Won or lost
+  // positions are the exception: they keep their score at larger depths.
+  // A position and its mirror image share their entry, which holds the
+  // moves of the canonical one.
+  const uint64_t key = board->CanonicalHash() ^ Zobrist::Side(pa);
+  const bool mirrored = board->Mirrored();
+  uint32_t tt_move = hint;
+  if (tt != NULL && depth > 0) {
+    TranspositionTable::Entry e;
+    const bool hit = tt->Probe(key, &e);
+    stats->TTProbe(hit);
+    if (hit) {
+      e.move = MirrorMove(*board, mirrored, e.move);
+      if (e.move != (uint32_t)~0) { tt_move = e.move; }
+      // The root result is never taken from the table, which may hold the
+      // move of another thread's search.
+      if (ply > 0 &&
+          (e.depth == depth || (!std::isfinite(e.value) && e.depth <= depth))) {
+        if (e.bound == TranspositionTable::EXACT ||
+            (e.bound == TranspositionTable::LOWER && e.value >= beta) ||
+            (e.bound == TranspositionTable::UPPER && e.value <= alpha)) {
+          stats->TTCutoff();
+          return std::pair<float,uint32_t>(e.value, e.move);
+        }
+      }
+    }
+  }
+  Evaluator* eval = (ctx != NULL ? ctx->eval : NULL);
+  float v = (eval != NULL ? (*eval)(pa, pb) : h(*board, pa, pb));
   if (std::isfinite(v) == false || depth == 0) {
+    stats->Leaf();
     return std::pair<float,uint32_t>(v, ~0);
   }
-  std::vector<std::pair<uint32_t, Board> > ch_board =
-      board.Expand(pa);
-  if (ch_board.size() == 0) {
+  size_t n = LegalMoves(*board, moves);
+  if (n == 0) {
+    stats->Leaf();
     return std::pair<float,uint32_t>(v, ~0);
   }
-  if (shuffle) {
-    std::shuffle(ch_board.begin(), ch_board.end(), PRNG);
+  // The moves right of the center of a symmetric position are the mirror
+  // images of the ones left of it, with the same scores.
+  const bool symmetric = board->Symmetric();
+  if (symmetric) {
+    while (n > 1 && 2 * moves[n - 1] + 1 > board->Cols()) { --n; }
+  }
+  std::default_random_engine& rng =
+      (ctx != NULL && ctx->rng != NULL ? *ctx->rng : PRNG);
+  MoveOrdering* ordering = (ctx != NULL ? ctx->ordering : NULL);
+  if (ordering != NULL) {
+    ordering->Order(*board, ply, tt_move, shuffle, rng, moves, n);
+  } else {
+    if (shuffle) {
+      std::shuffle(moves, moves + n, rng);
+    }
+    if (tt_move != (uint32_t)~0) {
+      MoveToFront(moves, n, tt_move);
+    }
   }
-  uint32_t m = ch_board.front().first;
+  const float alpha0 = alpha;
+  // At the root, ties are broken towards the leftmost move: a move left of
+  // the best one so far is searched with a slightly lower alpha, so that an
+  // equal score is exact.
+  const bool tie_break = (ply == 0 && !shuffle);
+  uint32_t m = moves[0];
   v = -INFINITY;
-  for (const auto& chb : ch_board) {
-    const float sc = -(NegamaxAlphaBeta(
-        chb.second, pb, pa, depth - 1, h, shuffle, -beta, -alpha, nodes).first);
-    if (sc > v) { v = sc; m = chb.first; }
+  for (size_t i = 0; i < n; ++i) {
+    const bool left = (tie_break && moves[i] < m && v == alpha);
+    // Once the root fails high, only the moves left of the best one could
+    // still change it.
+    if (tie_break && alpha >= beta && !left) continue;
+    const float a = (left ? std::nextafter(alpha, -INFINITY) : alpha);
+    const uint16_t row = board->Height(moves[i]);
+    board->Move(moves[i], pa);
+    float sc = +INFINITY;
+    if (!WinsAt(*board, moves[i], nodes, stats, ply + 1)) {
+      if (eval != NULL) { eval->Play(moves[i], row, pa); }
+      sc = -(NegamaxAlphaBetaRec(
+          board, pb, pa, depth - 1, h, shuffle, -beta, -a, moves + n,
+          nodes, ctx, stats, ~0, ply + 1).first);
+      if (eval != NULL) { eval->Undo(moves[i], row, pa); }
+    }
+    board->Undo(moves[i]);
+    if (sc > v || (left && sc == v)) { v = sc; m = moves[i]; }
     if (sc > alpha) { alpha = sc; }
-    if (alpha >= beta) { v = sc; m = chb.first; break; }
+    if (alpha >= beta && !tie_break) {
+      v = sc; m = moves[i];
+      stats->Cutoff(i == 0);
+      if (ordering != NULL) { ordering->Cutoff(*board, ply, m, depth); }
+      break;
+    }
+  }
+  // The score of an interrupted search is meaningless.
+  if (ctx != NULL && ctx->aborted) {
+    return std::pair<float,uint32_t>(0.0f, ~0);
+  }
+  if (tt != NULL) {
+    tt->Store(key, v, MirrorMove(*board, mirrored, m), depth,
+              v <= alpha0 ? TranspositionTable::UPPER :
+              (v >= beta ? TranspositionTable::LOWER :
+               TranspositionTable::EXACT));
+  }
+  // A shuffled root move may be either of the mirror images. Only the
+  // returned one is flipped: the table keeps the move that was searched.
+  if (symmetric && shuffle && ply == 0 && (rng() & 1)) {
+    m = board->Cols() - 1 - m;
   }
   return std::pair<float,uint32_t>(v, m);
 }
+
+// Seconds elapsed since t.
+inline double SecondsSince(const std::chrono::steady_clock::time_point& t) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - t).count();
+}
+
+template <class B, class H, class S>
+std::pair<float, uint32_t> IterativeSearch(
+    B* board, const uint8_t pa, const uint8_t pb, const size_t max_depth,
+    const H& h, const bool shuffle, uint32_t* moves, size_t* nodes,
+    SearchContext* ctx, S* stats, size_t* depth_reached) {
+  // Fallback in case not even the first iteration completes.
+  std::pair<float, uint32_t> best(-INFINITY, ~0);
+  if (LegalMoves(*board, moves) > 0) { best.second = moves[0]; }
+  *depth_reached = 0;
+  for (size_t d = 1; d <= max_depth; ++d) {
+    stats->BeginSearch();
+    const std::pair<float, uint32_t> r = NegamaxAlphaBetaRec(
+        board, pa, pb, d, h, shuffle, -INFINITY, +INFINITY, moves, nodes,
+        ctx, stats, best.second, 0);
+    if (ctx->aborted) break;
+    stats->EndSearch(d);
+    if (r.second != (uint32_t)~0) { best = r; }
+    *depth_reached = d;
+    // A won or lost position will not change with deeper searches.
+    if (!std::isfinite(r.first)) break;
+  }
+  return best;
+}
+
+}  // namespace
+
+template <class B, class H>
+std::pair<float, uint32_t> Negamax(
+    B* board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, size_t* nodes,
+    std::default_random_engine* rng, SearchStats* stats) {
+  std::vector<uint32_t> moves(board->Cols() * (depth + 1));
+  std::default_random_engine& r = (rng != NULL ? *rng : PRNG);
+  if (stats == NULL) {
+    NoSearchStats none;
+    return NegamaxRec(board, pa, pb, depth, h, shuffle, r, moves.data(),
+                      nodes, &none, 0);
+  }
+  const std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  stats->BeginSearch();
+  const std::pair<float, uint32_t> best = NegamaxRec(
+      board, pa, pb, depth, h, shuffle, r, moves.data(), nodes, stats, 0);
+  stats->EndSearch(depth);
+  stats->depth = std::max(stats->depth, depth);
+  stats->seconds += SecondsSince(t);
+  return best;
+}
+
+template <class B, class H>
+std::pair<float, uint32_t> Negamax(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, size_t* nodes,
+    std::default_random_engine* rng, SearchStats* stats) {
+  B b(board);
+  return Negamax(&b, pa, pb, depth, h, shuffle, nodes, rng, stats);
+}
+
+template <class B, class H>
+std::pair<float, uint32_t> NegamaxAlphaBeta(
+    B* board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, float alpha, float beta,
+    size_t* nodes, SearchContext* ctx) {
+  std::vector<uint32_t> moves(board->Cols() * (depth + 1));
+  SearchStats* stats = (ctx != NULL ? ctx->stats : NULL);
+  if (stats == NULL) {
+    NoSearchStats none;
+    return NegamaxAlphaBetaRec(board, pa, pb, depth, h, shuffle, alpha, beta,
+                               moves.data(), nodes, ctx, &none, ~0, 0);
+  }
+  const std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  stats->BeginSearch();
+  const std::pair<float, uint32_t> best = NegamaxAlphaBetaRec(
+      board, pa, pb, depth, h, shuffle, alpha, beta, moves.data(), nodes, ctx,
+      stats, ~0, 0);
+  if (!ctx->aborted) { stats->EndSearch(depth); }
+  stats->depth = std::max(stats->depth, depth);
+  stats->seconds += SecondsSince(t);
+  return best;
+}
+
+template <class B, class H>
+std::pair<float, uint32_t> NegamaxAlphaBeta(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, float alpha, float beta,
+    size_t* nodes, SearchContext* ctx) {
+  B b(board);
+  return NegamaxAlphaBeta(&b, pa, pb, depth, h, shuffle, alpha, beta, nodes,
+                          ctx);
+}
+
+template <class B, class H>
+std::pair<float, uint32_t> IterativeNegamaxAlphaBeta(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t max_depth,
+    const H& h, const bool shuffle, size_t* nodes, SearchContext* ctx,
+    size_t* depth_reached) {
+  CHECK_NOTNULL(ctx);
+  B b(board);
+  std::vector<uint32_t> moves(b.Cols() * (max_depth + 1));
+  size_t depth = 0;
+  if (ctx->stats == NULL) {
+    NoSearchStats none;
+    const std::pair<float, uint32_t> best = IterativeSearch(
+        &b, pa, pb, max_depth, h, shuffle, moves.data(), nodes, ctx, &none,
+        &depth);
+    if (depth_reached != NULL) { *depth_reached = depth; }
+    return best;
+  }
+  const std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  const std::pair<float, uint32_t> best = IterativeSearch(
+      &b, pa, pb, max_depth, h, shuffle, moves.data(), nodes, ctx, ctx->stats,
+      &depth);
+  ctx->stats->depth = std::max(ctx->stats->depth, depth);
+  ctx->stats->seconds += SecondsSince(t);
+  if (depth_reached != NULL) { *depth_reached = depth; }
+  return best;
+}
+
+namespace {
+
+template <class B, class H, class S>
+void HelperSearch(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const size_t first_depth, size_t* nodes,
+    SearchContext* ctx, S* stats) {
+  B b(board);
+  if (ctx->eval != NULL) { ctx->eval->Reset(b); }
+  std::vector<uint32_t> moves(b.Cols() * (depth + 1));
+  for (size_t d = first_depth; d <= depth && !ctx->aborted; ++d) {
+    NegamaxAlphaBetaRec(&b, pa, pb, d, h, true, -INFINITY, +INFINITY,
+                        moves.data(), nodes, ctx, stats, ~0, 0);
+  }
+}
+
+template <class B, class H>
+void HelperThread(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const size_t first_depth, size_t* nodes,
+    SearchContext* ctx) {
+  if (ctx->stats == NULL) {
+    NoSearchStats none;
+    HelperSearch(board, pa, pb, depth, h, first_depth, nodes, ctx, &none);
+  } else {
+    HelperSearch(board, pa, pb, depth, h, first_depth, nodes, ctx,
+                 ctx->stats);
+  }
+}
+
+}  // namespace
+
+template <class B, class H>
+std::pair<float, uint32_t> ParallelNegamaxAlphaBeta(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, const bool iterative,
+    size_t* nodes, SearchContext* ctx, std::vector<SearchContext>* helpers,
+    size_t* depth_reached) {
+  CHECK_NOTNULL(ctx); CHECK_NOTNULL(ctx->tt); CHECK_NOTNULL(helpers);
+  std::atomic<bool> stop(false);
+  std::vector<size_t> helper_nodes(helpers->size(), 0);
+  // The helpers count into their own statistics, merged once they stop.
+  std::vector<SearchStats> helper_stats(
+      ctx->stats != NULL ? helpers->size() : 0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < helpers->size(); ++i) {
+    SearchContext* hc = &(*helpers)[i];
+    hc->tt = ctx->tt;
+    hc->timed = ctx->timed;
+    hc->deadline = ctx->deadline;
+    hc->stop = &stop;
+    hc->aborted = false;
+    hc->stats = (ctx->stats != NULL ? &helper_stats[i] : NULL);
+    // Half of the helpers start one ply deeper, so that they are not all
+    // searching the same depth.
+    threads.push_back(std::thread(
+        HelperThread<B, H>, std::cref(board), pa, pb, depth, std::cref(h),
+        1 + (i & 1), &helper_nodes[i], hc));
+  }
+  const std::pair<float, uint32_t> best = iterative ?
+      IterativeNegamaxAlphaBeta(board, pa, pb, depth, h, shuffle, nodes, ctx,
+                                depth_reached) :
+      NegamaxAlphaBeta(board, pa, pb, depth, h, shuffle, -INFINITY,
+                       +INFINITY, nodes, ctx);
+  stop = true;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+    if (nodes != NULL) { *nodes += helper_nodes[i]; }
+    if (ctx->stats != NULL) { ctx->stats->Merge(helper_stats[i]); }
+    (*helpers)[i].stats = NULL;
+  }
+  return best;
+}
+
+#define INSTANTIATE_NEGAMAX(B, H)                                      \
+  template std::pair<float, uint32_t> Negamax<B, H>(                   \
+      B*, const uint8_t, const uint8_t, const size_t,                  \
+      const H&, const bool, size_t*,                                   \
+      std::default_random_engine*, SearchStats*);                      \
+  template std::pair<float, uint32_t> Negamax<B, H>(                   \
+      const B&, const uint8_t, const uint8_t, const size_t,            \
+      const H&, const bool, size_t*,                                   \
+      std::default_random_engine*, SearchStats*);                      \
+  template std::pair<float, uint32_t> NegamaxAlphaBeta<B, H>(          \
+      B*, const uint8_t, const uint8_t, const size_t,                  \
+      const H&, const bool, float, float, size_t*,                     \
+      SearchContext*);                                                 \
+  template std::pair<float, uint32_t> NegamaxAlphaBeta<B, H>(          \
+      const B&, const uint8_t, const uint8_t, const size_t,            \
+      const H&, const bool, float, float, size_t*,                     \
+      SearchContext*);                                                 \
+  template std::pair<float, uint32_t> IterativeNegamaxAlphaBeta<B, H>( \
+      const B&, const uint8_t, const uint8_t, const size_t,            \
+      const H&, const bool, size_t*, SearchContext*, size_t*);         \
+  template std::pair<float, uint32_t> ParallelNegamaxAlphaBeta<B, H>(  \
+      const B&, const uint8_t, const uint8_t, const size_t,            \
+      const H&, const bool, const bool, size_t*,                       \
+      SearchContext*, std::vector<SearchContext>*, size_t*)
+
+// The concrete heuristics get the specialized boards too.
+#define INSTANTIATE_NEGAMAX_BOARDS(H)                                  \
+  INSTANTIATE_NEGAMAX(Board, H);                                       \
+  INSTANTIATE_NEGAMAX(BitBoard, H);                                    \
+  INSTANTIATE_NEGAMAX(BitBoard7x6, H);                                 \
+  INSTANTIATE_NEGAMAX(BitBoard8x7, H)
+
+INSTANTIATE_NEGAMAX(Board, Heuristic);
+INSTANTIATE_NEGAMAX(BitBoard, Heuristic);
+INSTANTIATE_NEGAMAX_BOARDS(SimpleHeuristic);
+INSTANTIATE_NEGAMAX_BOARDS(WeightHeuristic);
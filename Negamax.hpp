@@ -3,16 +3,127 @@
 
 #include <utility>
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "BitBoard.hpp"
 #include "Board.hpp"
+#include "Evaluator.hpp"
 #include "Heuristic.hpp"
+#include "MoveOrdering.hpp"
+#include "SearchStats.hpp"
+#include "TranspositionTable.hpp"
 
+// Optional state shared by all the nodes of a NegamaxAlphaBeta search: a
+// transposition table, a move ordering stage, an incremental evaluator, a
+// random engine, a wall-clock deadline and search statistics.
+// Without a move ordering stage, moves are tried in column order (or in a
+// random order, if shuffle is set) after the transposition table move.
+// The evaluator, if given, replaces the heuristic and must be in sync with
+// the searched board. Moves are shuffled with rng, or with the global PRNG
+// if it is NULL. Once the deadline passes or stop is raised, the search
+// unwinds as fast as possible and its result must be discarded. Statistics
+// are only counted if stats is set.
+struct SearchContext {
+  TranspositionTable* tt;
+  MoveOrdering* ordering;
+  Evaluator* eval;
+  std::default_random_engine* rng;
+  bool timed;
+  std::chrono::steady_clock::time_point deadline;
+  const std::atomic<bool>* stop;
+  SearchStats* stats;
+  bool aborted;
+  size_t checks;
+  SearchContext()
+      : tt(NULL), ordering(NULL), eval(NULL), rng(NULL), timed(false),
+        stop(NULL), stats(NULL), aborted(false), checks(0) {}
+  inline bool Aborted() {
+    // Reading the clock is not free, check it every 1024 nodes only.
+    if (!aborted && (timed || stop != NULL) && (++checks & 0x3FF) == 0) {
+      if ((stop != NULL && stop->load(std::memory_order_relaxed)) ||
+          (timed && std::chrono::steady_clock::now() >= deadline)) {
+        aborted = true;
+      }
+    }
+    return aborted;
+  }
+};
+
+// Both search algorithms work either on a Board or on a BitBoard (or a
+// FixedBitBoard), and are templates over the heuristic so that concrete
+// heuristics are called directly. Negamax shuffles its moves with rng, or
+// with the global PRNG if it is NULL, and adds its statistics to stats, if
+// given. The variants taking a pointer play and undo the moves on the given
+// board (which is left as it was on return), the others search on a copy.
+// NegamaxAlphaBeta optionally stores and reuses results in a transposition
+// table, which also provides the first move to try at each node. Unless
+// shuffle is set, it returns the leftmost of the best root moves whatever
+// the move order, so neither the table nor the move ordering stage change
+// the chosen move.
+template <class B, class H>
+std::pair<float, uint32_t> Negamax(
+    B* board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, size_t* nodes = NULL,
+    std::default_random_engine* rng = NULL, SearchStats* stats = NULL);
+
+template <class B, class H>
 std::pair<float, uint32_t> Negamax(
-    const Board& board, const uint8_t pa, const uint8_t pb, const size_t depth,
-    const Heuristic& h, const bool shuffle, size_t* nodes = NULL);
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, size_t* nodes = NULL,
+    std::default_random_engine* rng = NULL, SearchStats* stats = NULL);
+
+template <class B, class H>
+std::pair<float, uint32_t> NegamaxAlphaBeta(
+    B* board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, float alpha, float beta,
+    size_t* nodes = NULL, SearchContext* ctx = NULL);
 
+template <class B, class H>
 std::pair<float, uint32_t> NegamaxAlphaBeta(
-    const Board& board, const uint8_t pa, const uint8_t pb, const size_t depth,
-    const Heuristic& h, const bool shuffle, float alpha, float beta,
-    size_t* nodes = NULL);
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, float alpha, float beta,
+    size_t* nodes = NULL, SearchContext* ctx = NULL);
+
+// Iterative deepening NegamaxAlphaBeta: searches with depth 1, 2, ... up to
+// max_depth or until the deadline of the context passes, and returns the
+// result of the deepest completed iteration. Each iteration tries first the
+// best move of the previous one (and the transposition table, if any, keeps
+// the best moves of the inner nodes).
+template <class B, class H>
+std::pair<float, uint32_t> IterativeNegamaxAlphaBeta(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t max_depth,
+    const H& h, const bool shuffle, size_t* nodes, SearchContext* ctx,
+    size_t* depth_reached = NULL);
+
+// Lazy SMP: runs NegamaxAlphaBeta (or IterativeNegamaxAlphaBeta, if
+// iterative is set) with ctx on the calling thread, while one thread per
+// helper context searches the same position with iterative deepening,
+// sharing the transposition table of ctx (which is required). Helpers shuffle
+// their moves with their own random engine and only feed the table: their
+// results are discarded and they stop as soon as the main search ends. The
+// result is the one of the main search, so the move is the same as the
+// single-threaded search unless shuffle is set. nodes and the statistics of
+// ctx count the nodes of all the threads.
+template <class B, class H>
+std::pair<float, uint32_t> ParallelNegamaxAlphaBeta(
+    const B& board, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const H& h, const bool shuffle, const bool iterative,
+    size_t* nodes, SearchContext* ctx, std::vector<SearchContext>* helpers,
+    size_t* depth_reached = NULL);
+
+// Runtime dispatcher of the board representation: calls f with a copy of b
+// in the fastest representation the searches are instantiated for, that is
+// a FixedBitBoard for the common sizes (7x6 and 8x7), a BitBoard for the
+// other sizes it fits, or b itself, and returns its result. F must define
+// result_type and a templated operator () taking the board.
+template <class F>
+typename F::result_type WithSearchBoard(const Board& b, const F& f) {
+  if (b.Cols() == 7 && b.Rows() == 6) return f(BitBoard7x6(b));
+  if (b.Cols() == 8 && b.Rows() == 7) return f(BitBoard8x7(b));
+  if (BitBoard::Fits(b.Cols(), b.Rows())) return f(BitBoard(b));
+  return f(b);
+}
 
 #endif
@@ -0,0 +1,100 @@
+#include "OpeningBook.hpp"
+
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+
+static const char kMagic[8] = {'C', '4', 'B', 'O', 'O', 'K', '\0', '\0'};
+
+// Keys are read in place from the mapping, so they must stay aligned.
+static_assert(sizeof(OpeningBook::Header) % sizeof(uint64_t) == 0,
+              "The book header breaks the alignment of the keys");
+
+OpeningBook::OpeningBook(const std::string& path)
+    : map_(MAP_FAILED), map_size_(0), keys_(NULL), data_(NULL) {
+  memset(&header_, 0, sizeof(header_));
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(WARNING) << "Book \"" << path << "\" could not be opened";
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+    LOG(WARNING) << "Book \"" << path << "\" is too small";
+    close(fd);
+    return;
+  }
+  map_size_ = st.st_size;
+  map_ = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map_ == MAP_FAILED) {
+    LOG(WARNING) << "Book \"" << path << "\" could not be mapped";
+    return;
+  }
+  memcpy(&header_, map_, sizeof(Header));
+  const size_t expected = sizeof(Header) +
+      header_.entries * (sizeof(uint64_t) + sizeof(uint16_t));
+  if (memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header_.version != kVersion || header_.mode > SOLVE ||
+      header_.entries > map_size_ || expected != map_size_) {
+    LOG(WARNING) << "Book \"" << path << "\" is not a valid version "
+                 << kVersion << " book";
+    munmap(map_, map_size_);
+    map_ = MAP_FAILED;
+    memset(&header_, 0, sizeof(header_));
+    return;
+  }
+  const char* base = static_cast<const char*>(map_);
+  keys_ = reinterpret_cast<const uint64_t*>(base + sizeof(Header));
+  data_ = reinterpret_cast<const uint16_t*>(keys_ + header_.entries);
+}
+
+OpeningBook::~OpeningBook() {
+  if (map_ != MAP_FAILED) { munmap(map_, map_size_); }
+}
+
+bool OpeningBook::Probe(const uint64_t key, uint32_t* move, int* score) const {
+  if (keys_ == NULL) return false;
+  const uint64_t* end = keys_ + header_.entries;
+  const uint64_t* it = std::lower_bound(keys_, end, key);
+  if (it == end || *it != key) return false;
+  const uint16_t d = data_[it - keys_];
+  if (move != NULL) { *move = d & 0xFF; }
+  if (score != NULL) { *score = (int8_t)(d >> 8); }
+  return true;
+}
+
+bool OpeningBook::Write(const std::string& path, Header header,
+                        std::vector<Entry>* entries) {
+  CHECK_NOTNULL(entries);
+  std::sort(entries->begin(), entries->end(),
+            [](const Entry& a, const Entry& b) { return a.key < b.key; });
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.entries = entries->size();
+  std::vector<uint64_t> keys(entries->size());
+  std::vector<uint16_t> data(entries->size());
+  for (size_t i = 0; i < entries->size(); ++i) {
+    keys[i] = (*entries)[i].key;
+    data[i] = (*entries)[i].move | ((uint8_t)(*entries)[i].score << 8);
+    CHECK(i == 0 || keys[i - 1] != keys[i]) << "Duplicated book position";
+  }
+  const std::string tmp = path + ".tmp";
+  std::ofstream of(tmp.c_str(), std::ios::binary);
+  if (!of.is_open()) return false;
+  of.write((const char*)&header, sizeof(Header));
+  of.write((const char*)keys.data(), keys.size() * sizeof(uint64_t));
+  of.write((const char*)data.data(), data.size() * sizeof(uint16_t));
+  of.close();
+  if (!of) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return rename(tmp.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,67 @@
+#ifndef OPENING_BOOK_HPP_
+#define OPENING_BOOK_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Read-only opening book, memory-mapped from a file written by
+// book_builder. The file is a fixed header followed by the sorted position
+// keys (BitBoard::CanonicalKey of the player to move, so a position and its
+// mirror image share one entry) and, in the same order, one 16-bit entry
+// per position with the best move of the canonical position and its score.
+// Opening a book only maps the file and checks its header, and probes are a
+// binary search over the mapped keys, so nothing is parsed or copied at
+// startup.
+class OpeningBook {
+ public:
+  static const uint32_t kVersion = 2;
+  typedef enum {SEARCH = 0, SOLVE = 1} Mode;
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint16_t cols;
+    uint16_t rows;
+    // Positions with less than this number of discs are in the book.
+    uint32_t plies;
+    uint32_t mode;
+    // Search depth of the positions, or 0 if they were solved.
+    uint32_t depth;
+    uint32_t reserved;
+    uint64_t entries;
+    // Heuristic weights of the search (unused by solved books).
+    float weights[6];
+    uint8_t padding[8];
+  };
+  struct Entry {
+    uint64_t key;
+    uint8_t move;
+    // Solver score, or 0 if the position was searched.
+    int8_t score;
+  };
+  // Maps the book at path. If it cannot be opened or its header is not
+  // valid, the book is left closed and the reason is logged.
+  explicit OpeningBook(const std::string& path);
+  ~OpeningBook();
+  inline bool IsOpen() const { return keys_ != NULL; }
+  inline const Header& GetHeader() const { return header_; }
+  inline size_t Size() const { return header_.entries; }
+  // Finds the position with the given key and, if it is in the book, sets
+  // its move (and score, if given).
+  bool Probe(const uint64_t key, uint32_t* move, int* score = NULL) const;
+  // Writes a book with the given entries (sorted by Write) atomically: the
+  // data is written to a temporary file, which is then renamed.
+  static bool Write(const std::string& path, Header header,
+                    std::vector<Entry>* entries);
+ private:
+  Header header_;
+  void* map_;
+  size_t map_size_;
+  const uint64_t* keys_;
+  const uint16_t* data_;
+  OpeningBook(const OpeningBook&);
+  OpeningBook& operator = (const OpeningBook&);
+};
+
+#endif  // OPENING_BOOK_HPP_
@@ -1,14 +1,43 @@
 #include "Player.hpp"
 
 #include <glog/logging.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
 #include <random>
 #include <chrono>
 
 extern std::default_random_engine PRNG;
 
+namespace {
+
+// Whether a search with the heuristic scores the positions like the search
+// that built a book. book_builder searches with WeightHeuristic.
+bool SameHeuristic(const OpeningBook::Header& header,
+                   const WeightHeuristic& heur) {
+  return memcmp(header.weights, heur.Weights(), sizeof(header.weights)) == 0;
+}
+
+bool SameHeuristic(const OpeningBook::Header& header,
+                   const SimpleHeuristic& heur) {
+  return false;
+}
+
+}  // namespace
+
 Player::Player(const uint8_t player_ids[2])
-    : player_ids_{player_ids[0], player_ids[1]} {}
+    : player_ids_{player_ids[0], player_ids[1]}, rng_(NULL), last_nodes_(0),
+      collect_stats_(false), has_move_start_(false) {}
+
+std::default_random_engine& Player::Rng() const {
+  return rng_ != NULL ? *rng_ : PRNG;
+}
+
+std::chrono::steady_clock::time_point Player::MoveStart() {
+  if (!has_move_start_) return std::chrono::steady_clock::now();
+  has_move_start_ = false;
+  return move_start_;
+}
 
 uint8_t Player::Id() const {
   return player_ids_[0];
@@ -51,13 +80,34 @@ uint32_t RandomPlayer::Move(const Board& b) {
     return 0;
   }
   std::uniform_int_distribution<uint16_t> uniform(0, not_full_cols.size() - 1);
-  const uint32_t mov = not_full_cols[uniform(PRNG)];
+  const uint32_t mov = not_full_cols[uniform(Rng())];
   const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
   const std::chrono::duration<float> ts = t2 - t1;
   LOG(INFO) << "Player = " << player_ids_[0] << ": Nodes = " << 0 << ", Time = " << ts.count() << "sec.";
   return mov;
 }
 
+namespace {
+
+// Negamax on the board representation chosen by WithSearchBoard.
+template <class H>
+struct NegamaxSearch {
+  typedef std::pair<float, uint32_t> result_type;
+  uint8_t pa, pb;
+  size_t depth;
+  const H* h;
+  bool shuffle;
+  size_t* nodes;
+  std::default_random_engine* rng;
+  SearchStats* stats;
+  template <class B>
+  result_type operator () (const B& b) const {
+    return Negamax(b, pa, pb, depth, *h, shuffle, nodes, rng, stats);
+  }
+};
+
+}  // namespace
+
 // NegamaxPlayer generic
 template <class Heuristic>
 NegamaxPlayer<Heuristic>::NegamaxPlayer(
@@ -71,12 +121,16 @@ NegamaxPlayer<Heuristic>::NegamaxPlayer(
 template<class Heuristic>
 uint32_t NegamaxPlayer<Heuristic>::Move(const Board& b) {
   size_t num_nodes = 0;
+  last_stats_.Clear();
+  SearchStats* stats = (collect_stats_ ? &last_stats_ : NULL);
   const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
-  const std::pair<float, uint32_t> best_move =
-      Negamax(b, player_ids_[0], player_ids_[1], max_depth_, heuristic_,
-              shuff_, &num_nodes);
+  const NegamaxSearch<Heuristic> search = {
+    player_ids_[0], player_ids_[1], max_depth_, &heuristic_, shuff_,
+    &num_nodes, &Rng(), stats};
+  const std::pair<float, uint32_t> best_move = WithSearchBoard(b, search);
   const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
   const std::chrono::duration<float> ts = t2 - t1;
+  last_nodes_ = num_nodes;
   LOG(INFO) << "Player = " << player_ids_[0] << ": Nodes = " << num_nodes << ", Time = " << ts.count() << "sec.";
   return best_move.second;
 }
@@ -85,25 +139,299 @@ uint32_t NegamaxPlayer<Heuristic>::Move(const Board& b) {
 template <class Heuristic>
 NegamaxAlphaBetaPlayer<Heuristic>::NegamaxAlphaBetaPlayer(
     const uint8_t player_ids[2], const size_t max_depth, const Heuristic& heur,
-    const bool shuffle) : Player(player_ids), max_depth_(max_depth),
-                          heuristic_(heur), shuff_(shuffle) {
+    const bool shuffle, const size_t tt_size_mb, const size_t movetime_ms,
+    const bool move_ordering, const size_t search_threads,
+    const std::string& book, const bool ponder)
+    : Player(player_ids), max_depth_(max_depth), heuristic_(heur),
+      shuff_(shuffle),
+      own_tt_(tt_size_mb > 0 ? new TranspositionTable(tt_size_mb) : NULL),
+      tt_(own_tt_.get()),
+      movetime_ms_(movetime_ms), move_ordering_(move_ordering),
+      search_threads_(tt_ ? std::max<size_t>(search_threads, 1) : 1),
+      ponder_(ponder && tt_), ponder_stop_(false), ponder_move_(~0),
+      ponder_nodes_(0), ponder_depth_(0) {
+  if (search_threads > 1 && !tt_) {
+    LOG(WARNING) << "Player = " << player_ids_[0]
+                 << ": The parallel search needs a transposition table";
+  }
+  if (ponder && !tt_) {
+    LOG(WARNING) << "Player = " << player_ids_[0]
+                 << ": Pondering needs a transposition table";
+  }
   LOG(INFO) << "Player = " << player_ids_[0] << ": Type = " << "NegamaxAlphaBeta";
-  LOG(INFO) << "Player = " << player_ids_[0] << ": Depth = " << max_depth_;
+  if (movetime_ms_ > 0) {
+    LOG(INFO) << "Player = " << player_ids_[0] << ": Time = " << movetime_ms_
+              << "ms.";
+  } else {
+    LOG(INFO) << "Player = " << player_ids_[0] << ": Depth = " << max_depth_;
+  }
+  LOG(INFO) << "Player = " << player_ids_[0] << ": TT Entries = "
+            << (tt_ ? tt_->Entries() : 0);
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Move Ordering = "
+            << move_ordering_;
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Search Threads = "
+            << search_threads_;
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Ponder = " << ponder_;
+  if (!book.empty()) {
+    book_.reset(new OpeningBook(book));
+    if (!book_->IsOpen()) { book_.reset(); }
+  }
+  // The moves of a searched book are only the ones this player would play
+  // if it was searched with the same heuristic, and at least as deep
+  // (a timed search may reach any depth, so any book saves it time).
+  if (book_ && book_->GetHeader().mode == OpeningBook::SEARCH) {
+    const OpeningBook::Header& header = book_->GetHeader();
+    if (!SameHeuristic(header, heuristic_)) {
+      LOG(WARNING) << "Player = " << player_ids_[0] << ": The book was "
+                   << "searched with another heuristic or other weights ("
+                   << header.weights[0] << ", " << header.weights[1] << ", "
+                   << header.weights[2] << ", " << header.weights[3] << ", "
+                   << header.weights[4] << ", " << header.weights[5]
+                   << "). Not using it";
+      book_.reset();
+    } else if (movetime_ms_ == 0 && header.depth < max_depth_) {
+      LOG(WARNING) << "Player = " << player_ids_[0] << ": The book was "
+                   << "searched to depth " << header.depth << ", less than "
+                   << max_depth_ << ". Not using it";
+      book_.reset();
+    }
+  }
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Book Positions = "
+            << (book_ ? book_->Size() : 0);
+}
+
+template <class Heuristic>
+NegamaxAlphaBetaPlayer<Heuristic>::~NegamaxAlphaBetaPlayer() {
+  if (ponder_thread_.joinable()) {
+    ponder_stop_ = true;
+    ponder_thread_.join();
+  }
+}
+
+template <class Heuristic>
+void NegamaxAlphaBetaPlayer<Heuristic>::SetTranspositionTable(
+    TranspositionTable* tt) {
+  // The pondering thread may be using the current table.
+  if (ponder_thread_.joinable()) {
+    ponder_stop_ = true;
+    ponder_thread_.join();
+  }
+  tt_ = (tt != NULL ? tt : own_tt_.get());
 }
 
 template<class Heuristic>
 uint32_t NegamaxAlphaBetaPlayer<Heuristic>::Move(const Board& b) {
   size_t num_nodes = 0;
-  const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
-  const std::pair<float, uint32_t> best_move = NegamaxAlphaBeta(
-      b, player_ids_[0], player_ids_[1], max_depth_, heuristic_,
-      shuff_, -INFINITY, +INFINITY, &num_nodes);
+  last_stats_.Clear();
+  const std::chrono::steady_clock::time_point t1 = MoveStart();
+  const bool ponder_hit = StopPondering(b);
+  if (book_ && (book_->GetHeader().cols != b.Cols() ||
+                book_->GetHeader().rows != b.Rows())) {
+    LOG(WARNING) << "Player = " << player_ids_[0] << ": The book is for "
+                 << book_->GetHeader().cols << "x" << book_->GetHeader().rows
+                 << " boards";
+    book_.reset();
+  }
+  uint32_t book_move = 0;
+  bool in_book = false;
+  if (book_) {
+    // The book holds the moves of the canonical positions.
+    const BitBoard bb(b);
+    in_book = book_->Probe(bb.CanonicalKey(player_ids_[0]), &book_move);
+    if (in_book && bb.MirroredKey(player_ids_[0])) {
+      book_move = b.Cols() - 1 - book_move;
+    }
+  }
+  if (in_book && book_move < b.Cols() && b.Height(book_move) < b.Rows()) {
+    LOG(INFO) << "Player = " << player_ids_[0] << ": Book Move = "
+              << book_move;
+    last_nodes_ = 0;
+    return book_move;
+  }
+  if (tt_) { tt_->NewSearch(); }
+  if (move_ordering_) {
+    if (!ordering_) { ordering_.reset(new MoveOrdering(b.Cols(), b.Rows())); }
+    ordering_->NewSearch();
+  }
+  if (!eval_) {
+    eval_.reset(heuristic_.NewEvaluator(b.Cols(), b.Rows(), player_ids_[0],
+                                        player_ids_[1]));
+  }
+  if (eval_) { eval_->Reset(b); }
+  SearchContext ctx;
+  ctx.tt = tt_;
+  ctx.ordering = ordering_.get();
+  ctx.eval = eval_.get();
+  ctx.rng = &Rng();
+  ctx.stats = (collect_stats_ ? &last_stats_ : NULL);
+  if (search_threads_ > 1 && helpers_.empty()) {
+    helpers_.resize(search_threads_ - 1);
+    for (size_t i = 0; i < helpers_.size(); ++i) {
+      if (move_ordering_) {
+        helpers_[i].ordering.reset(new MoveOrdering(b.Cols(), b.Rows()));
+      }
+      helpers_[i].eval.reset(heuristic_.NewEvaluator(
+          b.Cols(), b.Rows(), player_ids_[0], player_ids_[1]));
+      helpers_[i].rng.seed(Rng()());
+    }
+  }
+  std::vector<SearchContext> helper_ctx(helpers_.size());
+  for (size_t i = 0; i < helpers_.size(); ++i) {
+    if (helpers_[i].ordering) { helpers_[i].ordering->NewSearch(); }
+    helper_ctx[i].ordering = helpers_[i].ordering.get();
+    helper_ctx[i].eval = helpers_[i].eval.get();
+    helper_ctx[i].rng = &helpers_[i].rng;
+  }
+  // On a ponder hit, the pondering searched this board already (as the
+  // reply it expected), so its time counts as spent on this move, and its
+  // result is kept in case it is deeper than the search below. The search
+  // still gets a tenth of the budget to go through the table.
+  TranspositionTable::Entry pondered;
+  pondered.depth = 0;
+  if (movetime_ms_ > 0) {
+    ctx.timed = true;
+    ctx.deadline = t1 + std::chrono::milliseconds(movetime_ms_);
+    if (ponder_hit) {
+      ctx.deadline = std::max(
+          ponder_start_ + std::chrono::milliseconds(movetime_ms_),
+          t1 + std::chrono::milliseconds(movetime_ms_) / 10);
+      const bool hit = tt_->Probe(
+          b.CanonicalHash() ^ Zobrist::Side(player_ids_[0]), &pondered);
+      if (hit && b.Mirrored() && pondered.move < b.Cols()) {
+        pondered.move = b.Cols() - 1 - pondered.move;
+      }
+      if (!hit ||
+          pondered.bound != TranspositionTable::EXACT ||
+          pondered.move >= b.Cols() || b.Height(pondered.move) >= b.Rows()) {
+        pondered.depth = 0;
+      }
+    }
+  }
+  size_t depth = 0;
+  const SearchOn search = {
+    this, player_ids_[0], player_ids_[1],
+    max_depth_, movetime_ms_ > 0, &ctx,
+    &helper_ctx, &num_nodes, &depth};
+  std::pair<float, uint32_t> best_move = WithSearchBoard(b, search);
+  if (pondered.depth > depth) {
+    best_move = std::pair<float, uint32_t>(pondered.value, pondered.move);
+    depth = pondered.depth;
+  }
+  if (movetime_ms_ > 0) {
+    LOG(INFO) << "Player = " << player_ids_[0] << ": Depth = " << depth;
+  }
   const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
   const std::chrono::duration<float> ts = t2 - t1;
+  last_nodes_ = num_nodes;
   LOG(INFO) << "Player = " << player_ids_[0] << ": Nodes = " << num_nodes << ", Time = " << ts.count() << "sec.";
+  if (ponder_) { StartPondering(b, best_move.second); }
   return best_move.second;
 }
 
+template <class Heuristic>
+void NegamaxAlphaBetaPlayer<Heuristic>::StartPondering(const Board& b,
+                                                       const uint32_t move) {
+  ponder_board_.reset(new Board(b));
+  if (!ponder_board_->Move(move, player_ids_[0]) ||
+      ponder_board_->WinsAt(move) || ponder_board_->CheckFull()) {
+    ponder_board_.reset();
+    return;
+  }
+  ponder_rng_.seed(Rng()());
+  ponder_stop_ = false;
+  ponder_move_ = ~0;
+  ponder_nodes_ = 0;
+  ponder_depth_ = 0;
+  ponder_start_ = std::chrono::steady_clock::now();
+  // Move is not running meanwhile, so the thread can use the table, the
+  // move ordering, the evaluators and the helpers of the player.
+  ponder_thread_ = std::thread([this]() {
+      if (tt_) { tt_->NewSearch(); }
+      if (ordering_) { ordering_->NewSearch(); }
+      if (eval_) { eval_->Reset(*ponder_board_); }
+      SearchContext ctx;
+      ctx.tt = tt_;
+      ctx.ordering = ordering_.get();
+      ctx.eval = eval_.get();
+      ctx.rng = &ponder_rng_;
+      ctx.stop = &ponder_stop_;
+      std::vector<SearchContext> helper_ctx(helpers_.size());
+      for (size_t i = 0; i < helpers_.size(); ++i) {
+        if (helpers_[i].ordering) { helpers_[i].ordering->NewSearch(); }
+        helper_ctx[i].ordering = helpers_[i].ordering.get();
+        helper_ctx[i].eval = helpers_[i].eval.get();
+        helper_ctx[i].rng = &helpers_[i].rng;
+      }
+      // The next move searches max_depth_ plies at most one ply below this
+      // board, so deeper entries would not be reused.
+      const SearchOn search = {
+        this, player_ids_[1], player_ids_[0], max_depth_ + 1, true, &ctx,
+        &helper_ctx, &ponder_nodes_, &ponder_depth_};
+      ponder_move_ = WithSearchBoard(*ponder_board_, search).second;
+    });
+}
+
+template <class Heuristic>
+bool NegamaxAlphaBetaPlayer<Heuristic>::StopPondering(const Board& b) {
+  if (!ponder_thread_.joinable()) return false;
+  ponder_stop_ = true;
+  ponder_thread_.join();
+  Board predicted(*ponder_board_);
+  const bool hit = (ponder_move_ < predicted.Cols() &&
+                    predicted.Move(ponder_move_, player_ids_[1]) &&
+                    predicted == b);
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Ponder Nodes = "
+            << ponder_nodes_ << ", Ponder Depth = " << ponder_depth_
+            << ", Ponder Hit = " << hit;
+  return hit;
+}
+
+template <class Heuristic>
+struct NegamaxAlphaBetaPlayer<Heuristic>::SearchOn {
+  typedef std::pair<float, uint32_t> result_type;
+  NegamaxAlphaBetaPlayer* player;
+  uint8_t pa;
+  uint8_t pb;
+  size_t depth;
+  bool iterative;
+  SearchContext* ctx;
+  std::vector<SearchContext>* helper_ctx;
+  size_t* nodes;
+  size_t* depth_reached;
+  template <class B>
+  result_type operator () (const B& b) const {
+    return player->Search(b, pa, pb, depth, iterative, ctx, helper_ctx, nodes,
+                          depth_reached);
+  }
+};
+
+template <class Heuristic>
+template <class B>
+std::pair<float, uint32_t> NegamaxAlphaBetaPlayer<Heuristic>::Search(
+    const B& b, const uint8_t pa, const uint8_t pb, const size_t depth,
+    const bool iterative, SearchContext* ctx,
+    std::vector<SearchContext>* helper_ctx, size_t* nodes,
+    size_t* depth_reached) {
+  if (iterative) {
+    // No search can go deeper than the number of empty cells.
+    size_t empty = b.Cols() * b.Rows();
+    for (uint16_t c = 0; c < b.Cols(); ++c) { empty -= b.Height(c); }
+    const size_t d = std::min(depth, empty);
+    if (!helper_ctx->empty()) {
+      return ParallelNegamaxAlphaBeta(b, pa, pb, d, heuristic_, shuff_, true,
+                                      nodes, ctx, helper_ctx, depth_reached);
+    }
+    return IterativeNegamaxAlphaBeta(b, pa, pb, d, heuristic_, shuff_, nodes,
+                                     ctx, depth_reached);
+  }
+  if (!helper_ctx->empty()) {
+    return ParallelNegamaxAlphaBeta(b, pa, pb, depth, heuristic_, shuff_,
+                                    false, nodes, ctx, helper_ctx);
+  }
+  return NegamaxAlphaBeta(b, pa, pb, depth, heuristic_, shuff_, -INFINITY,
+                          +INFINITY, nodes, ctx);
+}
+
 // SimpleHeuristic with Negamax
 SimpleHeuristic_NegamaxPlayer::SimpleHeuristic_NegamaxPlayer(
     const uint8_t player_ids[2], const size_t max_depth, const bool shuffle)
@@ -127,9 +455,13 @@ WeightHeuristic_NegamaxPlayer::WeightHeuristic_NegamaxPlayer(
 
 // SimpleHeuristic with Negamax and Alpha-Beta pruning
 SimpleHeuristic_NegamaxAlphaBetaPlayer::SimpleHeuristic_NegamaxAlphaBetaPlayer(
-    const uint8_t player_ids[2], const size_t max_depth, const bool shuffle)
+    const uint8_t player_ids[2], const size_t max_depth, const bool shuffle,
+    const size_t tt_size_mb, const size_t movetime_ms,
+    const bool move_ordering, const size_t search_threads,
+    const std::string& book, const bool ponder)
     : NegamaxAlphaBetaPlayer(
-        player_ids, max_depth, SimpleHeuristic(), shuffle) {
+        player_ids, max_depth, SimpleHeuristic(), shuffle, tt_size_mb,
+        movetime_ms, move_ordering, search_threads, book, ponder) {
   LOG(INFO) << "Player = " << player_ids_[0]
             << ": Heuristic = Heuristic00";
 }
@@ -137,9 +469,12 @@ SimpleHeuristic_NegamaxAlphaBetaPlayer::SimpleHeuristic_NegamaxAlphaBetaPlayer(
 // WeightHeuristic with Negamax and Alpha-Beta pruning
 WeightHeuristic_NegamaxAlphaBetaPlayer::WeightHeuristic_NegamaxAlphaBetaPlayer(
     const uint8_t player_ids[2], const size_t max_depth,
-    const float weights[6], const bool shuffle)
+    const float weights[6], const bool shuffle, const size_t tt_size_mb,
+    const size_t movetime_ms, const bool move_ordering,
+    const size_t search_threads, const std::string& book, const bool ponder)
     : NegamaxAlphaBetaPlayer(
-        player_ids, max_depth, WeightHeuristic(weights), shuffle) {
+        player_ids, max_depth, WeightHeuristic(weights), shuffle, tt_size_mb,
+        movetime_ms, move_ordering, search_threads, book, ponder) {
   LOG(INFO) << "Player = " << player_ids_[0]
             << ": Heuristic = Heuristic01";
   LOG(INFO) << "Player = " << player_ids_[0] << ": Weights = "
@@ -148,15 +483,92 @@ WeightHeuristic_NegamaxAlphaBetaPlayer::WeightHeuristic_NegamaxAlphaBetaPlayer(
             << weights[4] << ", " << weights[5];
 }
 
+// Solver
+SolverPlayer::SolverPlayer(const uint8_t player_ids[2], const size_t tt_size_mb)
+    : Player(player_ids), tt_size_mb_(tt_size_mb > 0 ? tt_size_mb : 16) {
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Type = " << "Solver";
+  LOG(INFO) << "Player = " << player_ids_[0] << ": TT Size = " << tt_size_mb_
+            << "MB";
+}
+
+uint32_t SolverPlayer::Move(const Board& b) {
+  const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  if (!solver_) { solver_.reset(new Solver(b.Cols(), b.Rows(), tt_size_mb_)); }
+  size_t num_nodes = 0;
+  const Solver::Result res = solver_->Solve(b, player_ids_[0], player_ids_[1],
+                                            &num_nodes);
+  const char* outcome[] = {"Loss", "Draw", "Win"};
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Score = " << res.score
+            << " (" << outcome[res.outcome + 1] << " in " << res.distance
+            << " moves)";
+  const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  const std::chrono::duration<float> ts = t2 - t1;
+  last_nodes_ = num_nodes;
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Nodes = " << num_nodes << ", Time = " << ts.count() << "sec.";
+  return res.move;
+}
+
+// MCTS
+MCTSPlayer::MCTSPlayer(const uint8_t player_ids[2], const size_t playouts,
+                       const size_t movetime_ms, const size_t search_threads,
+                       const bool root_parallel, const size_t tree_size_mb)
+    : Player(player_ids), playouts_(playouts), movetime_ms_(movetime_ms),
+      search_threads_(std::max<size_t>(search_threads, 1)),
+      mcts_(std::max<size_t>(tree_size_mb, 1), search_threads_,
+            root_parallel) {
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Type = " << "MCTS";
+  if (movetime_ms_ > 0) {
+    LOG(INFO) << "Player = " << player_ids_[0] << ": Time = " << movetime_ms_
+              << "ms.";
+  } else {
+    LOG(INFO) << "Player = " << player_ids_[0] << ": Playouts = "
+              << playouts_;
+  }
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Search Threads = "
+            << search_threads_ << (root_parallel ? " (root)" : " (tree)");
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Tree Nodes = "
+            << mcts_.Capacity();
+}
+
+struct MCTSPlayer::SearchOn {
+  typedef MCTS::Result result_type;
+  MCTS* mcts;
+  uint8_t pa, pb;
+  size_t playouts;
+  bool timed;
+  std::chrono::steady_clock::time_point deadline;
+  std::default_random_engine* rng;
+  template <class B>
+  result_type operator () (const B& b) const {
+    return mcts->Search(b, pa, pb, playouts, timed, deadline, rng);
+  }
+};
+
+uint32_t MCTSPlayer::Move(const Board& b) {
+  const std::chrono::steady_clock::time_point t1 = MoveStart();
+  const SearchOn search = {
+    &mcts_, player_ids_[0], player_ids_[1], playouts_, movetime_ms_ > 0,
+    t1 + std::chrono::milliseconds(movetime_ms_), &Rng()};
+  const MCTS::Result res = WithSearchBoard(b, search);
+  const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  const std::chrono::duration<float> ts = t2 - t1;
+  last_nodes_ = res.playouts;
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Value = " << res.value
+            << ", Tree Nodes = " << res.nodes;
+  LOG(INFO) << "Player = " << player_ids_[0] << ": Playouts = " << res.playouts << ", Time = " << ts.count() << "sec., Playouts/s/core = " << (ts.count() > 0 ? res.playouts / ts.count() / search_threads_ : 0.0f);
+  return res.move;
+}
+
 NetworkPlayer::NetworkPlayer(const uint8_t player_ids[2], const int fd)
     : Player(player_ids), sockfd(fd) {}
 
 uint32_t NetworkPlayer::Move(const Board& b) {
-  char* buff = NULL;
-  size_t size = 0;
-  size_t mov = 0;
-  b.Serialize(&buff, &size);
-  CHECK_EQ(write(sockfd, buff, size), size);
-  CHECK_EQ(read(sockfd, &mov, sizeof(uint32_t)), sizeof(uint32_t));
+  // The buffer is kept between moves, so it is only allocated once.
+  buff_.resize(Board::EncodedSize(b.Cols(), b.Rows()));
+  const size_t size = b.Encode(buff_.data(), buff_.size());
+  CHECK_GT(size, 0);
+  CHECK_EQ(write(sockfd, buff_.data(), size), (ssize_t)size);
+  uint32_t mov = 0;
+  CHECK_EQ(read(sockfd, &mov, sizeof(mov)), (ssize_t)sizeof(mov));
   return mov;
 }
@@ -2,19 +2,64 @@
 #define PLAYER_HPP_
 
 #include "Board.hpp"
+#include "Evaluator.hpp"
 #include "Heuristic.hpp"
+#include "MCTS.hpp"
+#include "MoveOrdering.hpp"
 #include "Negamax.hpp"
+#include "OpeningBook.hpp"
+#include "Solver.hpp"
+#include "TranspositionTable.hpp"
 
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 class Player {
  protected:
   const uint8_t player_ids_[2];
+  // Random engine of the player, or NULL to use the global PRNG.
+  std::default_random_engine* rng_;
+  size_t last_nodes_;
+  bool collect_stats_;
+  SearchStats last_stats_;
+  bool has_move_start_;
+  std::chrono::steady_clock::time_point move_start_;
+  std::default_random_engine& Rng() const;
+  // Start of the time budget of this move: the time given to SetMoveStart,
+  // if any, or else now.
+  std::chrono::steady_clock::time_point MoveStart();
  public:
   Player(const uint8_t player_ids[2]);
   virtual ~Player() {};
   virtual uint8_t Id() const;
   virtual uint32_t Move(const Board& b) = 0;
+  // Makes the player draw its random numbers from rng (not owned) instead
+  // of the global PRNG, so several games can run at once reproducibly.
+  inline void SetRandomEngine(std::default_random_engine* rng) { rng_ = rng; }
+  // Makes the next Move count its time budget from t (e.g. when the request
+  // for it arrived) instead of from the call. A move whose budget is spent
+  // by then only gets a shallow search.
+  inline void SetMoveStart(const std::chrono::steady_clock::time_point& t) {
+    has_move_start_ = true;
+    move_start_ = t;
+  }
+  // Makes the AlphaBeta players search with tt (not owned, and only used by
+  // one search at a time) instead of their own table, or with their own
+  // again if tt is NULL. The other players have no table.
+  virtual void SetTranspositionTable(TranspositionTable* tt) {}
+  // Nodes searched for the last move.
+  inline size_t LastNodes() const { return last_nodes_; }
+  // Makes the Negamax and AlphaBeta players count the statistics of each
+  // move, returned by LastStats (which is left empty otherwise). The solver
+  // and the MCTS players count none, so their LastStats is always empty.
+  inline void CollectStats(const bool collect) { collect_stats_ = collect; }
+  inline const SearchStats& LastStats() const { return last_stats_; }
 };
 
 class HumanPlayer : public Player {
@@ -45,12 +90,74 @@ template <class Heuristic>
 class NegamaxAlphaBetaPlayer : public Player {
  public:
   NegamaxAlphaBetaPlayer(const uint8_t player_ids[2], const size_t max_depth,
-                         const Heuristic& heur, const bool shuffle);
+                         const Heuristic& heur, const bool shuffle,
+                         const size_t tt_size_mb = 0,
+                         const size_t movetime_ms = 0,
+                         const bool move_ordering = false,
+                         const size_t search_threads = 1,
+                         const std::string& book = "",
+                         const bool ponder = false);
+  virtual ~NegamaxAlphaBetaPlayer();
   virtual uint32_t Move(const Board& b);
+  virtual void SetTranspositionTable(TranspositionTable* tt);
  private:
+  // State of the helper threads of the parallel search.
+  struct Helper {
+    std::unique_ptr<MoveOrdering> ordering;
+    std::unique_ptr<Evaluator> eval;
+    std::default_random_engine rng;
+  };
   const size_t max_depth_;
   const Heuristic heuristic_;
   const bool shuff_;
+  // Table of the player, and the one it searches with (its own, or the one
+  // given to SetTranspositionTable).
+  std::unique_ptr<TranspositionTable> own_tt_;
+  TranspositionTable* tt_;
+  // When non-zero, search with iterative deepening for this time per move,
+  // still stopping at max_depth_.
+  const size_t movetime_ms_;
+  // Killer moves and history scores, created on the first move once the
+  // board size is known.
+  const bool move_ordering_;
+  std::unique_ptr<MoveOrdering> ordering_;
+  // Incremental evaluator of the heuristic (if it has one), also created on
+  // the first move.
+  std::unique_ptr<Evaluator> eval_;
+  // Threads searching each move (Lazy SMP), including the calling one.
+  const size_t search_threads_;
+  std::vector<Helper> helpers_;
+  // Opening book probed before searching, if any.
+  std::unique_ptr<OpeningBook> book_;
+  // Pondering: after each searched move, a thread keeps searching the
+  // board after it from the opponent's side until the next call to Move,
+  // leaving its results in the transposition table. If the opponent plays
+  // the reply it found best, the time already spent counts towards
+  // movetime_ms_.
+  const bool ponder_;
+  std::thread ponder_thread_;
+  std::atomic<bool> ponder_stop_;
+  std::unique_ptr<Board> ponder_board_;
+  uint32_t ponder_move_;
+  size_t ponder_nodes_;
+  size_t ponder_depth_;
+  std::chrono::steady_clock::time_point ponder_start_;
+  std::default_random_engine ponder_rng_;
+  void StartPondering(const Board& b, const uint32_t move);
+  // Stops the pondering thread, if running, and returns whether b is the
+  // board it predicted.
+  bool StopPondering(const Board& b);
+  // Searches the move on the board representation chosen by
+  // WithSearchBoard.
+  struct SearchOn;
+  // Searches for pa up to depth, iteratively deepening if iterative is set
+  // (up to the number of empty cells at most).
+  template <class B>
+  std::pair<float, uint32_t> Search(
+      const B& b, const uint8_t pa, const uint8_t pb, const size_t depth,
+      const bool iterative, SearchContext* ctx,
+      std::vector<SearchContext>* helper_ctx, size_t* nodes,
+      size_t* depth_reached);
 };
 
 class SimpleHeuristic_NegamaxPlayer : public NegamaxPlayer<SimpleHeuristic> {
@@ -70,7 +177,10 @@ class SimpleHeuristic_NegamaxAlphaBetaPlayer :
     public NegamaxAlphaBetaPlayer<SimpleHeuristic> {
  public:
   SimpleHeuristic_NegamaxAlphaBetaPlayer(
-      const uint8_t player_ids[2], const size_t max_depth, const bool shuffle);
+      const uint8_t player_ids[2], const size_t max_depth, const bool shuffle,
+      const size_t tt_size_mb = 0, const size_t movetime_ms = 0,
+      const bool move_ordering = false, const size_t search_threads = 1,
+      const std::string& book = "", const bool ponder = false);
 };
 
 class WeightHeuristic_NegamaxAlphaBetaPlayer :
@@ -78,7 +188,41 @@ class WeightHeuristic_NegamaxAlphaBetaPlayer :
  public:
   WeightHeuristic_NegamaxAlphaBetaPlayer(
       const uint8_t player_ids[2], const size_t max_depth,
-      const float weights[6], const bool shuffle);
+      const float weights[6], const bool shuffle,
+      const size_t tt_size_mb = 0, const size_t movetime_ms = 0,
+      const bool move_ordering = false, const size_t search_threads = 1,
+      const std::string& book = "", const bool ponder = false);
+};
+
+// Plays perfectly using the exact Solver. Only supports the board sizes of
+// BitBoard, and positions close to the start of the game can take long.
+class SolverPlayer : public Player {
+ public:
+  SolverPlayer(const uint8_t player_ids[2], const size_t tt_size_mb);
+  virtual uint32_t Move(const Board& b);
+ private:
+  const size_t tt_size_mb_;
+  // Created on the first move, once the board size is known.
+  std::unique_ptr<Solver> solver_;
+};
+
+// Monte Carlo Tree Search (UCT) player: runs the given number of playouts
+// per move or, if movetime_ms is non-zero, as many as fit in that time, on
+// search_threads threads. The tree takes tree_size_mb of memory.
+class MCTSPlayer : public Player {
+ public:
+  MCTSPlayer(const uint8_t player_ids[2], const size_t playouts,
+             const size_t movetime_ms = 0, const size_t search_threads = 1,
+             const bool root_parallel = false,
+             const size_t tree_size_mb = 16);
+  virtual uint32_t Move(const Board& b);
+ private:
+  const size_t playouts_;
+  const size_t movetime_ms_;
+  const size_t search_threads_;
+  MCTS mcts_;
+  // MCTS on the board representation chosen by WithSearchBoard.
+  struct SearchOn;
 };
 
 class NetworkPlayer : public Player {
@@ -87,6 +231,7 @@ class NetworkPlayer : public Player {
   virtual uint32_t Move(const Board& b);
  private:
   const int sockfd;
+  std::vector<char> buff_;
 };
 
 
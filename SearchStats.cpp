@@ -0,0 +1,75 @@
+#include "SearchStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void SearchStats::Clear() {
+  nodes.clear();
+  leaves = 0;
+  cutoffs = 0;
+  first_cutoffs = 0;
+  tt_probes = 0;
+  tt_hits = 0;
+  tt_cutoffs = 0;
+  depth = 0;
+  seconds = 0.0;
+  search_depth = 0;
+  search_nodes = 0;
+  search_start = 0;
+}
+
+void SearchStats::Merge(const SearchStats& o) {
+  if (o.nodes.size() > nodes.size()) { nodes.resize(o.nodes.size(), 0); }
+  for (size_t i = 0; i < o.nodes.size(); ++i) { nodes[i] += o.nodes[i]; }
+  leaves += o.leaves;
+  cutoffs += o.cutoffs;
+  first_cutoffs += o.first_cutoffs;
+  tt_probes += o.tt_probes;
+  tt_hits += o.tt_hits;
+  tt_cutoffs += o.tt_cutoffs;
+  depth = std::max(depth, o.depth);
+}
+
+uint64_t SearchStats::Nodes() const {
+  uint64_t n = 0;
+  for (size_t i = 0; i < nodes.size(); ++i) { n += nodes[i]; }
+  return n;
+}
+
+double SearchStats::FirstCutoffRate() const {
+  return cutoffs > 0 ? (double)first_cutoffs / cutoffs : 0.0;
+}
+
+double SearchStats::EffectiveBranchingFactor() const {
+  const double n = search_nodes;
+  if (search_depth == 0 || n == 0) return 0.0;
+  // The size of the tree grows with b, so bisect between 0 and n.
+  double lo = 0.0, hi = n;
+  for (int it = 0; it < 64; ++it) {
+    const double b = 0.5 * (lo + hi);
+    double size = 1.0, level = 1.0;
+    for (size_t d = 1; d <= search_depth && size <= n; ++d) {
+      level *= b;
+      size += level;
+    }
+    if (size > n) { hi = b; } else { lo = b; }
+  }
+  return 0.5 * (lo + hi);
+}
+
+void SearchStats::WriteJson(std::ostream& os) const {
+  os << "{\"depth\":" << depth << ",\"nodes\":" << Nodes()
+     << ",\"nodes_per_ply\":[";
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    os << (i > 0 ? "," : "") << nodes[i];
+  }
+  os << "],\"leaves\":" << leaves << ",\"cutoffs\":" << cutoffs
+     << ",\"first_cutoffs\":" << first_cutoffs
+     << ",\"first_cutoff_rate\":" << FirstCutoffRate()
+     << ",\"search_depth\":" << search_depth
+     << ",\"search_nodes\":" << search_nodes
+     << ",\"ebf\":" << EffectiveBranchingFactor()
+     << ",\"tt_probes\":" << tt_probes << ",\"tt_hits\":" << tt_hits
+     << ",\"tt_cutoffs\":" << tt_cutoffs << ",\"seconds\":" << seconds
+     << "}";
+}
@@ -0,0 +1,83 @@
+#ifndef SEARCH_STATS_HPP_
+#define SEARCH_STATS_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+#include <vector>
+
+// Statistics of a search, filled by Negamax and NegamaxAlphaBeta when they
+// are given one. Counters are accumulated over all the searches run with
+// it (e.g. the iterations of iterative deepening) until Clear.
+// The searches are templates over the statistics policy: without a
+// SearchStats they run with NoSearchStats, whose calls compile to nothing.
+struct SearchStats {
+  // Nodes searched at each ply from the root.
+  std::vector<uint64_t> nodes;
+  // Nodes scored by the heuristic (or as won) instead of expanded.
+  uint64_t leaves;
+  // Beta cutoffs, and how many of them came from the first move tried.
+  uint64_t cutoffs;
+  uint64_t first_cutoffs;
+  // Transposition table probes, probes finding the position and probes
+  // whose result was used without searching.
+  uint64_t tt_probes;
+  uint64_t tt_hits;
+  uint64_t tt_cutoffs;
+  // Deepest search depth and total time of the searches.
+  size_t depth;
+  double seconds;
+  // Depth and nodes of the last completed search (with iterative
+  // deepening, the last iteration which was not aborted), and Nodes() when
+  // the current search began.
+  size_t search_depth;
+  uint64_t search_nodes;
+  uint64_t search_start;
+  SearchStats() { Clear(); }
+  void Clear();
+  // Adds the counters of a search running at the same time (e.g. a helper
+  // thread). Time is not added, since it overlaps.
+  void Merge(const SearchStats& o);
+  uint64_t Nodes() const;
+  // Fraction of the cutoffs produced by the first move.
+  double FirstCutoffRate() const;
+  // Branching factor b of the uniform tree of the depth and number of nodes
+  // of the last completed search: search_nodes = 1 + b + ... + b^depth.
+  // Earlier iterations are left out, since they would inflate it.
+  double EffectiveBranchingFactor() const;
+  // Writes the statistics as a single-line JSON object.
+  void WriteJson(std::ostream& os) const;
+
+  inline void Node(const size_t ply) {
+    if (ply >= nodes.size()) { nodes.resize(ply + 1, 0); }
+    ++nodes[ply];
+  }
+  inline void Leaf() { ++leaves; }
+  inline void Cutoff(const bool first) {
+    ++cutoffs;
+    if (first) { ++first_cutoffs; }
+  }
+  inline void TTProbe(const bool hit) {
+    ++tt_probes;
+    if (hit) { ++tt_hits; }
+  }
+  inline void TTCutoff() { ++tt_cutoffs; }
+  inline void BeginSearch() { search_start = Nodes(); }
+  inline void EndSearch(const size_t d) {
+    search_depth = d;
+    search_nodes = Nodes() - search_start;
+  }
+};
+
+// Statistics policy which counts nothing.
+struct NoSearchStats {
+  inline void Node(const size_t) {}
+  inline void Leaf() {}
+  inline void Cutoff(const bool) {}
+  inline void TTProbe(const bool) {}
+  inline void TTCutoff() {}
+  inline void BeginSearch() {}
+  inline void EndSearch(const size_t) {}
+};
+
+#endif  // SEARCH_STATS_HPP_
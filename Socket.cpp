@@ -0,0 +1,128 @@
+#include "Socket.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Creates a socket for the address and binds it (if listening) or connects
+// it.
+int OpenSocket(const std::string& address, const bool listening) {
+  const std::string path = UnixSocketPath(address);
+  if (!path.empty()) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (listening) { unlink(path.c_str()); }
+    const int r = listening ?
+        bind(fd, (const sockaddr*)&addr, sizeof(addr)) :
+        connect(fd, (const sockaddr*)&addr, sizeof(addr));
+    if (r != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+  const size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    errno = EINVAL;
+    return -1;
+  }
+  const std::string host = address.substr(0, colon);
+  const std::string port = address.substr(colon + 1);
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (listening) { hints.ai_flags = AI_PASSIVE; }
+  addrinfo* res = NULL;
+  if (getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints,
+                  &res) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  int fd = -1;
+  for (addrinfo* ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) continue;
+    const int one = 1;
+    if (listening) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    } else {
+      // Messages are small and answered right away.
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    const int r = listening ? bind(fd, ai->ai_addr, ai->ai_addrlen) :
+        connect(fd, ai->ai_addr, ai->ai_addrlen);
+    if (r != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+}  // namespace
+
+int ListenSocket(const std::string& address) {
+  const int fd = OpenSocket(address, true);
+  if (fd < 0) return -1;
+  if (listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int ConnectSocket(const std::string& address) {
+  return OpenSocket(address, false);
+}
+
+std::string UnixSocketPath(const std::string& address) {
+  return address.compare(0, 5, "unix:") == 0 ? address.substr(5) : "";
+}
+
+bool ReadAll(const int fd, void* buf, size_t n) {
+  char* p = static_cast<char*>(buf);
+  while (n > 0) {
+    const ssize_t r = recv(fd, p, n, 0);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) return false;
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+bool WriteAll(const int fd, const void* buf, size_t n) {
+  const char* p = static_cast<const char*>(buf);
+  while (n > 0) {
+    const ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) return false;
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+bool SetNonBlocking(const int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
@@ -0,0 +1,22 @@
+#ifndef SOCKET_HPP_
+#define SOCKET_HPP_
+
+#include <stddef.h>
+#include <string>
+
+// Stream sockets on an address, either host:port for TCP (an empty host
+// listens on all the interfaces) or unix:path for a Unix socket. Both
+// return the socket or -1 on failure, with errno set.
+int ListenSocket(const std::string& address);
+int ConnectSocket(const std::string& address);
+// Path of the Unix socket of the address, or an empty string for TCP.
+std::string UnixSocketPath(const std::string& address);
+
+// Blocking reads and writes of exactly n bytes. They return false on errors
+// and when the other side closes the connection.
+bool ReadAll(const int fd, void* buf, size_t n);
+bool WriteAll(const int fd, const void* buf, size_t n);
+
+bool SetNonBlocking(const int fd);
+
+#endif  // SOCKET_HPP_
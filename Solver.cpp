@@ -0,0 +1,203 @@
+#include "Solver.hpp"
+
+#include "BitBoard.hpp"
+#include "Zobrist.hpp"
+
+#include <glog/logging.h>
+#include <cstdlib>
+
+bool Solver::Supports(const uint16_t cols, const uint16_t rows) {
+  return BitBoard::Fits(cols, rows);
+}
+
+Solver::Solver(const uint16_t cols, const uint16_t rows,
+               const size_t tt_size_mb)
+    : cols_(cols), rows_(rows), cells_(cols * rows), bottom_(0), board_(0),
+      column_(cols), tt_(new TranspositionTable(tt_size_mb)), nodes_(0) {
+  CHECK(Supports(cols_, rows_)) << "Board " << cols_ << "x" << rows_
+                                << " is not supported by the solver";
+  for (uint16_t c = 0; c < cols_; ++c) {
+    column_[c] = ((UINT64_C(1) << rows_) - 1) << (c * (rows_ + 1));
+    bottom_ |= UINT64_C(1) << (c * (rows_ + 1));
+    board_ |= column_[c];
+  }
+  for (int i = 0; i < cols_; ++i) {
+    order_.push_back(cols_ / 2 + (1 - 2 * (i % 2)) * ((i + 1) / 2));
+  }
+}
+
+uint64_t Solver::WinningCells(const uint64_t discs,
+                              const uint64_t mask) const {
+  const int h1 = rows_ + 1;
+  // Vertical: only three discs below.
+  uint64_t r = (discs << 1) & (discs << 2) & (discs << 3);
+  // Horizontal and both diagonals: three discs around the cell, with
+  // shifts of h1, h1 - 1 and h1 + 1 respectively.
+  const int shifts[3] = {h1, h1 - 1, h1 + 1};
+  for (int i = 0; i < 3; ++i) {
+    const int s = shifts[i];
+    uint64_t p = (discs << s) & (discs << (2 * s));
+    r |= p & (discs << (3 * s));
+    r |= p & (discs >> s);
+    p = (discs >> s) & (discs >> (2 * s));
+    r |= p & (discs << s);
+    r |= p & (discs >> (3 * s));
+  }
+  return r & (board_ ^ mask);
+}
+
+// Moves that do not give the opponent an immediate win. If the opponent
+// threatens to win at two places, there are none.
+uint64_t Solver::NonLosingMoves(const Position& pos) const {
+  uint64_t possible = Possible(pos);
+  const uint64_t threats = WinningCells(pos.current ^ pos.mask, pos.mask);
+  const uint64_t forced = possible & threats;
+  if (forced != 0) {
+    if (forced & (forced - 1)) return 0;
+    possible = forced;
+  }
+  // Do not play right below a cell where the opponent would win.
+  return possible & ~(threats >> 1);
+}
+
+bool Solver::CanWinNext(const Position& pos) const {
+  return (WinningCells(pos.current, pos.mask) & Possible(pos)) != 0;
+}
+
+// Score of a position without its player to move being able to win with
+// its next move.
+int Solver::Negamax(const Position& pos, int alpha, int beta) {
+  ++nodes_;
+  const uint64_t next = NonLosingMoves(pos);
+  if (next == 0) return -(cells_ - (int)pos.moves) / 2;
+  // No one can win in the last two moves.
+  if ((int)pos.moves >= cells_ - 2) return 0;
+  const int min = -(cells_ - 2 - (int)pos.moves) / 2;
+  if (alpha < min) {
+    alpha = min;
+    if (alpha >= beta) return alpha;
+  }
+  int max = (cells_ - 1 - (int)pos.moves) / 2;
+  // A position and its mirror image share their entry.
+  const uint64_t k = pos.current + pos.mask;
+  const uint64_t mirror = BitBoard::Mirror(k, cols_, rows_);
+  const uint64_t key = Zobrist::Mix(mirror < k ? mirror : k);
+  TranspositionTable::Entry e;
+  if (tt_->Probe(key, &e)) {
+    const int value = (int)e.value;
+    if (e.bound == TranspositionTable::LOWER) {
+      if (value >= beta) return value;
+      if (value > alpha) alpha = value;
+    } else if (value < max) {
+      max = value;
+    }
+  }
+  if (beta > max) {
+    beta = max;
+    if (alpha >= beta) return beta;
+  }
+  // Sort the moves by the number of winning cells they create (stable
+  // insertion sort, so equally ranked moves stay center first).
+  uint64_t moves[64];
+  int scores[64];
+  size_t n = 0;
+  for (uint16_t i = 0; i < cols_; ++i) {
+    const uint64_t move = next & column_[order_[i]];
+    if (move == 0) continue;
+    const int score = __builtin_popcountll(
+        WinningCells(pos.current | move, pos.mask));
+    size_t j = n++;
+    for (; j > 0 && scores[j - 1] < score; --j) {
+      moves[j] = moves[j - 1];
+      scores[j] = scores[j - 1];
+    }
+    moves[j] = move;
+    scores[j] = score;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    const int score = -Negamax(Play(pos, moves[i]), -beta, -alpha);
+    if (score >= beta) {
+      tt_->Store(key, score, ~0, 0, TranspositionTable::LOWER);
+      return score;
+    }
+    if (score > alpha) alpha = score;
+  }
+  tt_->Store(key, alpha, ~0, 0, TranspositionTable::UPPER);
+  return alpha;
+}
+
+// Score of any position (the game must not be over).
+int Solver::Score(const Position& pos, int alpha, int beta) {
+  if (CanWinNext(pos)) return (cells_ + 1 - (int)pos.moves) / 2;
+  return Negamax(pos, alpha, beta);
+}
+
+int Solver::SolveScore(const Position& pos) {
+  if (CanWinNext(pos)) return (cells_ + 1 - (int)pos.moves) / 2;
+  int min = -(cells_ - (int)pos.moves) / 2;
+  int max = (cells_ + 1 - (int)pos.moves) / 2;
+  // Binary search on the score with null-window searches, trying first
+  // the scores closer to 0.
+  while (min < max) {
+    int med = min + (max - min) / 2;
+    if (med <= 0 && min / 2 < med) med = min / 2;
+    else if (med >= 0 && max / 2 > med) med = max / 2;
+    const int r = Negamax(pos, med, med + 1);
+    if (r <= med) max = r;
+    else min = r;
+  }
+  return min;
+}
+
+Solver::Result Solver::Solve(const Board& board, const uint8_t p,
+                             const uint8_t q, size_t* nodes) {
+  CHECK_EQ(board.Cols(), cols_); CHECK_EQ(board.Rows(), rows_);
+  Position pos = {0, 0, 0};
+  for (uint16_t c = 0; c < cols_; ++c) {
+    for (uint16_t r = 0; r < board.Height(c); ++r) {
+      const uint64_t bit = UINT64_C(1) << (c * (rows_ + 1) + r);
+      const uint8_t id = board.Get(c, r);
+      CHECK(id == p || id == q) << "Unknown player " << id;
+      pos.mask |= bit;
+      if (id == p) pos.current |= bit;
+      ++pos.moves;
+    }
+  }
+  CHECK(board.CheckWinner().player == Winner::NONE &&
+        (int)pos.moves < cells_) << "The game is over";
+  nodes_ = 0;
+  Result res;
+  res.score = SolveScore(pos);
+  res.outcome = res.score > 0 ? WIN : (res.score < 0 ? LOSS : DRAW);
+  const int left = cells_ - (int)pos.moves;
+  if (res.score > 0) {
+    res.distance = 2 * ((left + 1) / 2 - res.score) + 1;
+  } else if (res.score < 0) {
+    res.distance = 2 * (left / 2 + res.score) + 2;
+  } else {
+    res.distance = left;
+  }
+  // The first move (center first) that achieves the score.
+  res.move = ~0;
+  const uint64_t possible = Possible(pos);
+  for (uint16_t i = 0; i < cols_ && res.move == (uint32_t)~0; ++i) {
+    const uint64_t move = possible & column_[order_[i]];
+    if (move == 0) continue;
+    if (WinningCells(pos.current, pos.mask) & move) {
+      if (res.score == (cells_ + 1 - (int)pos.moves) / 2) res.move = order_[i];
+      continue;
+    }
+    const Position next = Play(pos, move);
+    // Draws of a full board.
+    if ((int)next.moves == cells_) {
+      if (res.score == 0) res.move = order_[i];
+      continue;
+    }
+    if (-Score(next, -res.score, -res.score + 1) >= res.score) {
+      res.move = order_[i];
+    }
+  }
+  CHECK_NE(res.move, (uint32_t)~0);
+  if (nodes != NULL) { *nodes = nodes_; }
+  return res;
+}
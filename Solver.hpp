@@ -0,0 +1,69 @@
+#ifndef SOLVER_HPP_
+#define SOLVER_HPP_
+
+#include "Board.hpp"
+#include "TranspositionTable.hpp"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+// Exact solver: finds the game-theoretic value of a position with a
+// null-window alpha-beta search, driven by a binary search on the score
+// (MTD(f) style). It works on a compact position (two 64-bit masks in the
+// BitBoard layout), so it supports the same board sizes as BitBoard.
+//
+// Scores follow the usual convention: 0 is a draw, a positive score means
+// the player to move wins, and the sooner the win, the higher the score. A
+// win with the k-th last disc of the winner scores k.
+class Solver {
+ public:
+  typedef enum {LOSS = -1, DRAW = 0, WIN = 1} Outcome;
+  struct Result {
+    Outcome outcome;
+    int score;
+    // Moves (of both players) until the end of the game with perfect play.
+    size_t distance;
+    // A best move, or ~0 if the game is over.
+    uint32_t move;
+  };
+  static bool Supports(const uint16_t cols, const uint16_t rows);
+  Solver(const uint16_t cols, const uint16_t rows, const size_t tt_size_mb);
+  // Solves the board for player p, who is to move, against player q. The
+  // game must not be over. nodes (if given) counts the searched positions.
+  Result Solve(const Board& board, const uint8_t p, const uint8_t q,
+               size_t* nodes = NULL);
+ private:
+  struct Position {
+    uint64_t current;  // Discs of the player to move.
+    uint64_t mask;     // All the discs.
+    uint32_t moves;
+  };
+  const uint16_t cols_;
+  const uint16_t rows_;
+  const int cells_;
+  uint64_t bottom_;
+  uint64_t board_;
+  std::vector<uint64_t> column_;
+  // Columns from the center outwards.
+  std::vector<uint16_t> order_;
+  std::unique_ptr<TranspositionTable> tt_;
+  size_t nodes_;
+  inline uint64_t Possible(const Position& pos) const {
+    return (pos.mask + bottom_) & board_;
+  }
+  inline Position Play(const Position& pos, const uint64_t move) const {
+    const Position next = {pos.current ^ pos.mask, pos.mask | move,
+                           pos.moves + 1};
+    return next;
+  }
+  uint64_t WinningCells(const uint64_t discs, const uint64_t mask) const;
+  uint64_t NonLosingMoves(const Position& pos) const;
+  bool CanWinNext(const Position& pos) const;
+  int Score(const Position& pos, int alpha, int beta);
+  int Negamax(const Position& pos, int alpha, int beta);
+  int SolveScore(const Position& pos);
+};
+
+#endif  // SOLVER_HPP_
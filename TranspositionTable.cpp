@@ -0,0 +1,93 @@
+#include "TranspositionTable.hpp"
+
+#include <glog/logging.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Entry data layout: value (32 bits) | move (16) | depth (8) | bound (2) |
+// generation (6).
+inline uint64_t Pack(const float value, const uint32_t move,
+                     const size_t depth, const uint8_t bound,
+                     const uint8_t generation) {
+  uint32_t v = 0;
+  memcpy(&v, &value, sizeof(float));
+  return (uint64_t(v) << 32) | (uint64_t(move & 0xFFFF) << 16) |
+      (uint64_t(depth < 0xFF ? depth : 0xFF) << 8) |
+      (uint64_t(bound & 0x03) << 6) | (generation & 0x3F);
+}
+
+inline uint8_t Depth(const uint64_t data) { return (data >> 8) & 0xFF; }
+inline uint8_t Generation(const uint64_t data) { return data & 0x3F; }
+
+}  // namespace
+
+TranspositionTable::TranspositionTable(const size_t size_mb)
+    : buckets_(NULL), num_buckets_(1), generation_(0) {
+  const size_t max_buckets = (size_mb << 20) / sizeof(Bucket);
+  CHECK_GT(max_buckets, 0) << "Transposition table is too small";
+  while (num_buckets_ * 2 <= max_buckets) num_buckets_ *= 2;
+  void* mem = NULL;
+  CHECK_EQ(posix_memalign(&mem, 64, num_buckets_ * sizeof(Bucket)), 0);
+  buckets_ = static_cast<Bucket*>(mem);
+  Clear();
+}
+
+TranspositionTable::~TranspositionTable() {
+  free(buckets_);
+}
+
+bool TranspositionTable::Probe(const uint64_t key, Entry* entry) const {
+  const Bucket& b = buckets_[key & (num_buckets_ - 1)];
+  for (size_t i = 0; i < kBucketEntries; ++i) {
+    const uint64_t data = b.slots[i].data.load(std::memory_order_relaxed);
+    const uint64_t check = b.slots[i].check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || data == 0) continue;
+    const uint32_t v = data >> 32;
+    memcpy(&entry->value, &v, sizeof(float));
+    entry->move = (data >> 16) & 0xFFFF;
+    if (entry->move == 0xFFFF) entry->move = ~0;
+    entry->depth = Depth(data);
+    entry->bound = static_cast<Bound>((data >> 6) & 0x03);
+    return true;
+  }
+  return false;
+}
+
+void TranspositionTable::Store(
+    const uint64_t key, const float value, const uint32_t move,
+    const size_t depth, const Bound bound) {
+  Bucket& b = buckets_[key & (num_buckets_ - 1)];
+  // Replace the entry of the same position, if any. Otherwise, replace the
+  // least valuable one: empty entries first, then those from previous
+  // searches and then the shallowest ones.
+  size_t replace = 0;
+  int worst = 0x7FFFFFFF;
+  for (size_t i = 0; i < kBucketEntries; ++i) {
+    const uint64_t data = b.slots[i].data.load(std::memory_order_relaxed);
+    const uint64_t check = b.slots[i].check.load(std::memory_order_relaxed);
+    if (data == 0 || (check ^ data) == key) { replace = i; break; }
+    const int score = Depth(data) +
+        (Generation(data) == generation_ ? 0x100 : 0);
+    if (score < worst) { worst = score; replace = i; }
+  }
+  const uint64_t data = Pack(value, move, depth, bound, generation_);
+  b.slots[replace].data.store(data, std::memory_order_relaxed);
+  b.slots[replace].check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::NewSearch() {
+  // Generation 0 is never used, so that an all-zero slot is always empty.
+  generation_ = generation_ % 0x3F + 1;
+}
+
+void TranspositionTable::Clear() {
+  for (size_t i = 0; i < num_buckets_; ++i) {
+    for (size_t j = 0; j < kBucketEntries; ++j) {
+      buckets_[i].slots[j].check.store(0, std::memory_order_relaxed);
+      buckets_[i].slots[j].data.store(0, std::memory_order_relaxed);
+    }
+  }
+  NewSearch();
+}
@@ -0,0 +1,48 @@
+#ifndef TRANSPOSITION_TABLE_HPP_
+#define TRANSPOSITION_TABLE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Fixed-size transposition table. Entries are grouped in buckets of one
+// cache line, so a probe touches a single line of memory. Each entry stores
+// its key XOR-ed with its data, so torn or colliding entries are rejected
+// on probe. This makes the table safe to share between search threads
+// without locks (except NewSearch and Clear, which must not run during a
+// search).
+class TranspositionTable {
+ public:
+  typedef enum {EXACT, LOWER, UPPER} Bound;
+  struct Entry {
+    float value;
+    uint32_t move;
+    size_t depth;
+    Bound bound;
+  };
+  explicit TranspositionTable(const size_t size_mb);
+  ~TranspositionTable();
+  bool Probe(const uint64_t key, Entry* entry) const;
+  void Store(const uint64_t key, const float value, const uint32_t move,
+             const size_t depth, const Bound bound);
+  // Marks the entries stored so far as old, so they are replaced first.
+  void NewSearch();
+  void Clear();
+  inline size_t Entries() const { return num_buckets_ * kBucketEntries; }
+ private:
+  static const size_t kBucketEntries = 4;
+  struct Slot {
+    std::atomic<uint64_t> check;  // key ^ data
+    std::atomic<uint64_t> data;
+  };
+  struct Bucket {
+    Slot slots[kBucketEntries];
+  };
+  Bucket* buckets_;
+  size_t num_buckets_;
+  uint8_t generation_;
+  TranspositionTable(const TranspositionTable&);
+  TranspositionTable& operator = (const TranspositionTable&);
+};
+
+#endif  // TRANSPOSITION_TABLE_HPP_
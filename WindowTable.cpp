@@ -0,0 +1,223 @@
+#include "WindowTable.hpp"
+
+#include "BitBoard.hpp"
+
+#include <glog/logging.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+WindowTable::WindowTable(const uint16_t cols, const uint16_t rows)
+    : cols(cols), rows(rows) {
+  const bool fits = BitBoard::Fits(cols, rows);
+  // Same order as WeightHeuristic: for each cell, the vertical, horizontal,
+  // left-right diagonal and right-left diagonal windows starting there.
+  const int dirs[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+  for (int c = 0; c < cols; ++c) {
+    for (int r = 0; r < rows; ++r) {
+      for (int d = 0; d < 4; ++d) {
+        const int ec = c + 3 * dirs[d][0], er = r + 3 * dirs[d][1];
+        if (ec >= cols || er < 0 || er >= rows) continue;
+        uint64_t mask = 0;
+        for (int j = 0; j < 4; ++j) {
+          const int cc = c + j * dirs[d][0], rr = r + j * dirs[d][1];
+          cells[j].push_back(cc + rr * cols);
+          if (fits) { mask |= UINT64_C(1) << (cc * (rows + 1) + rr); }
+        }
+        if (fits) { masks.push_back(mask); }
+      }
+    }
+  }
+}
+
+const WindowTable& WindowTable::Get(const uint16_t cols, const uint16_t rows) {
+  // Most processes use a single board size: avoid the lock in that case.
+  static thread_local const WindowTable* last = NULL;
+  if (last != NULL && last->cols == cols && last->rows == rows) {
+    return *last;
+  }
+  static std::mutex mutex;
+  static std::map<std::pair<uint16_t, uint16_t>,
+                  std::unique_ptr<WindowTable> > tables;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<WindowTable>& t = tables[std::make_pair(cols, rows)];
+  if (!t) { t.reset(new WindowTable(cols, rows)); }
+  last = t.get();
+  return *last;
+}
+
+namespace {
+
+void PatternsScalar(
+    const WindowTable& t, const uint8_t* cells, const uint8_t pa,
+    const uint8_t pb, const size_t begin, const size_t end, uint8_t* out) {
+  for (size_t w = begin; w < end; ++w) {
+    uint8_t ca = 0, cb = 0;
+    for (int j = 0; j < 4; ++j) {
+      const uint8_t c = cells[t.cells[j][w]];
+      if (c == pa) { ++ca; }
+      else if (c == pb) { ++cb; }
+    }
+    out[w - begin] = 5 * ca + cb;
+  }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// Four windows per iteration: the cells of each window are packed in a
+// 32-bit lane and the discs of each player are counted with byte compares.
+__attribute__((target("sse2")))
+void PatternsSSE2(
+    const WindowTable& t, const uint8_t* cells, const uint8_t pa,
+    const uint8_t pb, const size_t begin, const size_t end, uint8_t* out) {
+  const __m128i va = _mm_set1_epi8(pa);
+  const __m128i vb = _mm_set1_epi8(pb);
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i low = _mm_set1_epi32(0xFF);
+  size_t w = begin;
+  for (; w + 4 <= end; w += 4) {
+    uint32_t packed[4];
+    for (int k = 0; k < 4; ++k) {
+      packed[k] = cells[t.cells[0][w + k]] |
+          (cells[t.cells[1][w + k]] << 8) |
+          (cells[t.cells[2][w + k]] << 16) |
+          (uint32_t(cells[t.cells[3][w + k]]) << 24);
+    }
+    const __m128i v = _mm_loadu_si128((const __m128i*)packed);
+    const __m128i is_a = _mm_cmpeq_epi8(v, va);
+    // As in the scalar version, a cell only counts for pb if not for pa.
+    const __m128i is_b = _mm_andnot_si128(is_a, _mm_cmpeq_epi8(v, vb));
+    __m128i ca = _mm_and_si128(is_a, one);
+    __m128i cb = _mm_and_si128(is_b, one);
+    ca = _mm_add_epi32(ca, _mm_srli_epi32(ca, 8));
+    ca = _mm_and_si128(_mm_add_epi32(ca, _mm_srli_epi32(ca, 16)), low);
+    cb = _mm_add_epi32(cb, _mm_srli_epi32(cb, 8));
+    cb = _mm_and_si128(_mm_add_epi32(cb, _mm_srli_epi32(cb, 16)), low);
+    const __m128i p = _mm_add_epi32(_mm_slli_epi32(ca, 2),
+                                    _mm_add_epi32(ca, cb));
+    uint32_t res[4];
+    _mm_storeu_si128((__m128i*)res, p);
+    for (int k = 0; k < 4; ++k) { out[w + k - begin] = res[k]; }
+  }
+  PatternsScalar(t, cells, pa, pb, w, end, out + (w - begin));
+}
+
+// Eight windows per iteration, gathering the cells of each window with
+// AVX2. cells must be readable up to 3 bytes past the last cell.
+__attribute__((target("avx2")))
+void PatternsAVX2(
+    const WindowTable& t, const uint8_t* cells, const uint8_t pa,
+    const uint8_t pb, const size_t begin, const size_t end, uint8_t* out) {
+  const __m256i va = _mm256_set1_epi32(pa);
+  const __m256i vb = _mm256_set1_epi32(pb);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i low = _mm256_set1_epi32(0xFF);
+  size_t w = begin;
+  for (; w + 8 <= end; w += 8) {
+    __m256i ca = _mm256_setzero_si256();
+    __m256i cb = _mm256_setzero_si256();
+    for (int j = 0; j < 4; ++j) {
+      const __m256i idx =
+          _mm256_loadu_si256((const __m256i*)(t.cells[j].data() + w));
+      const __m256i v = _mm256_and_si256(
+          _mm256_i32gather_epi32((const int*)cells, idx, 1), low);
+      const __m256i is_a = _mm256_cmpeq_epi32(v, va);
+      const __m256i is_b =
+          _mm256_andnot_si256(is_a, _mm256_cmpeq_epi32(v, vb));
+      ca = _mm256_add_epi32(ca, _mm256_and_si256(is_a, one));
+      cb = _mm256_add_epi32(cb, _mm256_and_si256(is_b, one));
+    }
+    const __m256i p = _mm256_add_epi32(_mm256_slli_epi32(ca, 2),
+                                       _mm256_add_epi32(ca, cb));
+    uint32_t res[8];
+    _mm256_storeu_si256((__m256i*)res, p);
+    for (int k = 0; k < 8; ++k) { out[w + k - begin] = res[k]; }
+  }
+  PatternsScalar(t, cells, pa, pb, w, end, out + (w - begin));
+}
+
+#endif  // HAVE_X86_KERNELS
+
+inline void MaskPatterns(
+    const WindowTable& t, const uint64_t da, const uint64_t db,
+    const size_t begin, const size_t end, uint8_t* out) {
+  for (size_t w = begin; w < end; ++w) {
+    const uint64_t m = t.masks[w];
+    out[w - begin] = 5 * __builtin_popcountll(da & m) +
+        __builtin_popcountll(db & m);
+  }
+}
+
+#ifdef HAVE_X86_KERNELS
+// Without it __builtin_popcountll is a library call.
+__attribute__((target("popcnt")))
+void MaskPatternsPopcnt(
+    const WindowTable& t, const uint64_t da, const uint64_t db,
+    const size_t begin, const size_t end, uint8_t* out) {
+  MaskPatterns(t, da, db, begin, end, out);
+}
+#endif  // HAVE_X86_KERNELS
+
+WindowKernel SelectWindowKernel() {
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+  if (__builtin_cpu_supports("sse2")) return KERNEL_SSE2;
+#endif
+  return KERNEL_SCALAR;
+}
+
+}  // namespace
+
+WindowKernel BestWindowKernel() {
+  static const WindowKernel kernel = SelectWindowKernel();
+  return kernel;
+}
+
+bool WindowKernelSupported(const WindowKernel kernel) {
+  switch (kernel) {
+    case KERNEL_SCALAR: return true;
+    case KERNEL_SSE2: return BestWindowKernel() != KERNEL_SCALAR;
+    case KERNEL_AVX2: return BestWindowKernel() == KERNEL_AVX2;
+    default: return false;
+  }
+}
+
+void ComputeWindowPatterns(
+    const WindowTable& t, const uint8_t* cells, const uint8_t pa,
+    const uint8_t pb, const size_t begin, const size_t end, uint8_t* out,
+    const WindowKernel kernel) {
+  DCHECK(WindowKernelSupported(kernel));
+  switch (kernel) {
+#ifdef HAVE_X86_KERNELS
+    case KERNEL_AVX2:
+      PatternsAVX2(t, cells, pa, pb, begin, end, out);
+      break;
+    case KERNEL_SSE2:
+      PatternsSSE2(t, cells, pa, pb, begin, end, out);
+      break;
+#endif
+    default:
+      PatternsScalar(t, cells, pa, pb, begin, end, out);
+  }
+}
+
+void ComputeWindowPatterns(
+    const WindowTable& t, const uint64_t da, const uint64_t db,
+    const size_t begin, const size_t end, uint8_t* out) {
+  DCHECK_EQ(t.masks.size(), t.Size());
+#ifdef HAVE_X86_KERNELS
+  static const bool popcnt = __builtin_cpu_supports("popcnt");
+  if (popcnt) {
+    MaskPatternsPopcnt(t, da, db, begin, end, out);
+    return;
+  }
+#endif
+  MaskPatterns(t, da, db, begin, end, out);
+}
@@ -0,0 +1,44 @@
+#ifndef WINDOW_TABLE_HPP_
+#define WINDOW_TABLE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Geometry of the 4-cell windows (vertical, horizontal and both diagonals)
+// of a board size, in the order WeightHeuristic scans them. Tables are built
+// once per board size and shared.
+struct WindowTable {
+  uint16_t cols;
+  uint16_t rows;
+  // Index (col + row * cols) of the j-th cell of each window: cells[j][w].
+  std::vector<uint32_t> cells[4];
+  // Mask of each window in the BitBoard layout (empty if the board does
+  // not fit in a BitBoard).
+  std::vector<uint64_t> masks;
+  inline size_t Size() const { return cells[0].size(); }
+  static const WindowTable& Get(const uint16_t cols, const uint16_t rows);
+ private:
+  WindowTable(const uint16_t cols, const uint16_t rows);
+};
+
+// Implementations of ComputeWindowPatterns. The best one supported by the
+// CPU is selected at runtime.
+typedef enum {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2} WindowKernel;
+WindowKernel BestWindowKernel();
+bool WindowKernelSupported(const WindowKernel kernel);
+
+// Writes in out[w - begin] the pattern of window w, for w in [begin, end):
+// 5 * (discs of pa) + (discs of pb). cells is the board in the Board layout
+// (one byte per cell, cell col + row * cols).
+void ComputeWindowPatterns(
+    const WindowTable& t, const uint8_t* cells, const uint8_t pa,
+    const uint8_t pb, const size_t begin, const size_t end, uint8_t* out,
+    const WindowKernel kernel = BestWindowKernel());
+
+// Same as above for a BitBoard, given the masks of the discs of each player.
+void ComputeWindowPatterns(
+    const WindowTable& t, const uint64_t da, const uint64_t db,
+    const size_t begin, const size_t end, uint8_t* out);
+
+#endif  // WINDOW_TABLE_HPP_
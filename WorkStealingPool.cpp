@@ -0,0 +1,86 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(const size_t num_threads)
+    : pending_(0), batch_(0), quit_(false) {
+  const size_t n = std::max<size_t>(num_threads, 1);
+  for (size_t i = 0; i < n; ++i) {
+    queues_.push_back(std::unique_ptr<Queue>(new Queue));
+  }
+  for (size_t i = 0; i < n; ++i) {
+    threads_.push_back(std::thread(&WorkStealingPool::Work, this, i));
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  work_cv_.notify_all();
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i].join();
+  }
+}
+
+void WorkStealingPool::Run(const size_t n,
+                           const std::function<void(size_t)>& task) {
+  if (n == 0) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_ = n;
+  const size_t t = queues_.size();
+  for (size_t q = 0; q < t; ++q) {
+    std::lock_guard<std::mutex> qlock(queues_[q]->mutex);
+    for (size_t i = q * n / t; i < (q + 1) * n / t; ++i) {
+      const Item item = {&task, i};
+      queues_[q]->items.push_back(item);
+    }
+  }
+  ++batch_;
+  work_cv_.notify_all();
+  done_cv_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+bool WorkStealingPool::Pop(const size_t id, Item* item) {
+  {
+    Queue& own = *queues_[id];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.items.empty()) {
+      *item = own.items.back();
+      own.items.pop_back();
+      return true;
+    }
+  }
+  for (size_t k = 1; k < queues_.size(); ++k) {
+    Queue& victim = *queues_[(id + k) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.items.empty()) {
+      *item = victim.items.front();
+      victim.items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::Work(const size_t id) {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [&]() { return quit_ || batch_ != seen; });
+      if (quit_) return;
+      seen = batch_;
+    }
+    Item item;
+    while (Pop(id, &item)) {
+      (*item.task)(item.index);
+      if (--pending_ == 0) {
+        // Lock so that the notification cannot be missed by Run.
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_cv_.notify_all();
+      }
+    }
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef WORK_STEALING_POOL_HPP_
+#define WORK_STEALING_POOL_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of threads running batches of independent tasks. Each
+// batch is split in contiguous blocks, one per thread queue. Threads take
+// tasks from the back of their own queue and, once it is empty, steal from
+// the front of the others, so no thread sits idle while there is work left.
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(const size_t num_threads);
+  ~WorkStealingPool();
+  // Runs task(i) for every i in [0, n) and waits until they are all done.
+  // Tasks may run in any order and on any thread.
+  void Run(const size_t n, const std::function<void(size_t)>& task);
+  inline size_t Size() const { return threads_.size(); }
+ private:
+  // A task of a batch. Threads may still be looking for work when the
+  // next batch starts, so each queued task carries its own function.
+  struct Item {
+    const std::function<void(size_t)>* task;
+    size_t index;
+  };
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Item> items;
+  };
+  std::vector<std::unique_ptr<Queue> > queues_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::atomic<size_t> pending_;
+  uint64_t batch_;
+  bool quit_;
+  void Work(const size_t id);
+  bool Pop(const size_t id, Item* item);
+  WorkStealingPool(const WorkStealingPool&);
+  WorkStealingPool& operator = (const WorkStealingPool&);
+};
+
+#endif  // WORK_STEALING_POOL_HPP_
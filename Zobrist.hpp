@@ -0,0 +1,27 @@
+#ifndef ZOBRIST_HPP_
+#define ZOBRIST_HPP_
+
+#include <stdint.h>
+
+// Zobrist keys used to hash board positions. Instead of a random table, the
+// key of each (column, row, player) triple is obtained by mixing its bits
+// with the SplitMix64 finalizer, so any board size and any player id is
+// supported and Board and BitBoard hash equal positions to equal values.
+struct Zobrist {
+  static inline uint64_t Mix(uint64_t x) {
+    x += UINT64_C(0x9E3779B97F4A7C15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+  }
+  static inline uint64_t Cell(
+      const uint16_t col, const uint16_t row, const uint8_t p) {
+    return Mix((uint64_t(col) << 24) | (uint64_t(row) << 8) | p);
+  }
+  // Key of the player to move.
+  static inline uint64_t Side(const uint8_t p) {
+    return Mix((UINT64_C(1) << 40) | p);
+  }
+};
+
+#endif  // ZOBRIST_HPP_
@@ -0,0 +1,154 @@
+#include "BitBoard.hpp"
+#include "Board.hpp"
+#include "OpeningBook.hpp"
+#include "Player.hpp"
+#include "Solver.hpp"
+#include "Utils.hpp"
+
+#include <glog/logging.h>
+#include <google/gflags.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+std::default_random_engine PRNG;
+
+DEFINE_string(o, "book.bin", "Output book filename");
+DEFINE_uint64(rows, 6, "Board rows");
+DEFINE_uint64(cols, 7, "Board columns");
+DEFINE_uint64(plies, 6, "Store the positions with less than this number of "
+              "discs");
+DEFINE_string(mode, "search", "How to find the best move of each position: "
+              "search (WeightAlphaBeta up to -max_depth) | solve (exact "
+              "Solver, slow for the first plies of big boards)");
+DEFINE_uint64(max_depth, 10, "Search depth");
+DEFINE_string(wh, "4;13;121;-10;-31;-128", "Values for weight heuristic");
+DEFINE_uint64(tt_size, 16, "Transposition table size (MB) of each thread");
+DEFINE_uint64(nthreads, 1, "Num threads");
+
+// Collects the positions with less than plies discs that are not over,
+// with the player to move ('O' moves first).
+static void Enumerate(Board* board, const uint8_t p, const uint8_t q,
+                      const size_t discs, const size_t plies,
+                      std::unordered_set<uint64_t>* seen,
+                      std::vector<Board>* positions) {
+  if (discs >= plies || board->CheckFull()) return;
+  // Mirror images share their entry: only the first one is kept.
+  if (!seen->insert(BitBoard(*board).CanonicalKey(p)).second) return;
+  positions->push_back(*board);
+  for (uint16_t c = 0; c < board->Cols(); ++c) {
+    if (board->Height(c) >= board->Rows()) continue;
+    board->Move(c, p);
+    if (!board->WinsAt(c)) {
+      Enumerate(board, q, p, discs + 1, plies, seen, positions);
+    }
+    board->Undo(c);
+  }
+}
+
+int main(int argc, char** argv) {
+  // Google tools initialization
+  google::InitGoogleLogging(argv[0]);
+  google::SetUsageMessage("Builds an opening book for connect4");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK(BitBoard::Fits(FLAGS_cols, FLAGS_rows))
+      << "Books do not support " << FLAGS_cols << "x" << FLAGS_rows
+      << " boards";
+  CHECK(FLAGS_mode == "search" || FLAGS_mode == "solve")
+      << "Wrong mode: \"" << FLAGS_mode << "\"";
+  const bool solve = FLAGS_mode == "solve";
+  std::vector<float> weights;
+  parseFloatList(FLAGS_wh.c_str(), &weights);
+  CHECK_EQ(weights.size(), 6);
+  LOG(INFO) << "-o " << FLAGS_o;
+  LOG(INFO) << "-rows " << FLAGS_rows;
+  LOG(INFO) << "-cols " << FLAGS_cols;
+  LOG(INFO) << "-plies " << FLAGS_plies;
+  LOG(INFO) << "-mode " << FLAGS_mode;
+  LOG(INFO) << "-max_depth " << FLAGS_max_depth;
+  LOG(INFO) << "-wh " << FLAGS_wh;
+  LOG(INFO) << "-tt_size " << FLAGS_tt_size;
+  LOG(INFO) << "-nthreads " << FLAGS_nthreads;
+
+  std::vector<Board> positions;
+  {
+    Board board(FLAGS_cols, FLAGS_rows);
+    std::unordered_set<uint64_t> seen;
+    Enumerate(&board, 'O', 'X', 0, FLAGS_plies, &seen, &positions);
+  }
+  LOG(INFO) << "Positions = " << positions.size();
+
+  const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  std::vector<OpeningBook::Entry> entries(positions.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < std::max<uint64_t>(FLAGS_nthreads, 1); ++t) {
+    threads.push_back(std::thread([&]() {
+          const uint8_t ids[2][2] = {{'O', 'X'}, {'X', 'O'}};
+          std::unique_ptr<Solver> solver;
+          std::unique_ptr<Player> players[2];
+          if (solve) {
+            solver.reset(new Solver(FLAGS_cols, FLAGS_rows, FLAGS_tt_size));
+          } else {
+            for (int p = 0; p < 2; ++p) {
+              players[p].reset(new WeightHeuristic_NegamaxAlphaBetaPlayer(
+                  ids[p], FLAGS_max_depth, weights.data(), false,
+                  FLAGS_tt_size, 0, true));
+            }
+          }
+          for (size_t i = next++; i < positions.size(); i = next++) {
+            const Board& b = positions[i];
+            size_t discs = 0;
+            for (uint16_t c = 0; c < b.Cols(); ++c) { discs += b.Height(c); }
+            const int p = discs % 2;
+            const BitBoard bb(b);
+            entries[i].key = bb.CanonicalKey(ids[p][0]);
+            if (solve) {
+              const Solver::Result res = solver->Solve(b, ids[p][0], ids[p][1]);
+              entries[i].move = res.move;
+              entries[i].score = res.score;
+            } else {
+              entries[i].move = players[p]->Move(b);
+              entries[i].score = 0;
+            }
+            // The move of the canonical position.
+            if (bb.MirroredKey(ids[p][0])) {
+              entries[i].move = b.Cols() - 1 - entries[i].move;
+            }
+            if ((i + 1) % 1000 == 0) {
+              LOG(INFO) << "Position " << i + 1 << " / " << positions.size();
+            }
+          }
+        }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  const std::chrono::duration<float> ts = t2 - t1;
+  LOG(INFO) << "Time = " << ts.count() << "sec.";
+
+  OpeningBook::Header header;
+  memset(&header, 0, sizeof(header));
+  header.cols = FLAGS_cols;
+  header.rows = FLAGS_rows;
+  header.plies = FLAGS_plies;
+  header.mode = solve ? OpeningBook::SOLVE : OpeningBook::SEARCH;
+  header.depth = solve ? 0 : FLAGS_max_depth;
+  if (!solve) {
+    for (int i = 0; i < 6; ++i) { header.weights[i] = weights[i]; }
+  }
+  CHECK(OpeningBook::Write(FLAGS_o, header, &entries))
+      << "File \"" << FLAGS_o << "\" could not been written.";
+  std::cout << "Wrote " << entries.size() << " positions to " << FLAGS_o
+            << std::endl;
+  return 0;
+}
@@ -16,15 +16,40 @@ DEFINE_uint64(rows, 6, "Board rows");
 DEFINE_uint64(cols, 7, "Board columns");
 DEFINE_uint64(seed, 0, "Random seed");
 DEFINE_string(ai, "Human:Human", "Valid intelligences: Human | Random | "
-              "SimpleNegamax | SimpleAlphaBeta | WeightNegamax | WeightAlphaBeta");
+              "SimpleNegamax | SimpleAlphaBeta | WeightNegamax | WeightAlphaBeta | "
+              "Solver | MCTS");
 DEFINE_string(max_depth, "5:5", "Max. depth for Minimax algorithm");
 DEFINE_string(wh, "4;13;121;-10;-31;-128:4;13;121;-10;-31;-128", "Values for weight heuristic");
 DEFINE_string(random, "0:0", "Non-deterministic Negamax algorithm");
+DEFINE_string(tt_size, "16:16", "Transposition table size (MB) for the "
+              "AlphaBeta players (use 0 to disable it), or tree size for the "
+              "MCTS players");
+DEFINE_string(movetime_ms, "0:0", "Time per move (ms) for the AlphaBeta "
+              "players, using iterative deepening up to -max_depth. Use 0 to "
+              "search -max_depth plies");
+DEFINE_string(move_ordering, "1:1", "Use killer moves, history heuristic and "
+              "center-first move ordering in the AlphaBeta players");
+DEFINE_string(search_threads, "1:1", "Threads searching each move of the "
+              "AlphaBeta players (Lazy SMP over the transposition table)");
+DEFINE_string(book, ":", "Opening book (built with book_builder) of the "
+              "AlphaBeta players. Leave empty to search every move");
+DEFINE_string(playouts, "100000:100000", "Playouts per move of the MCTS "
+              "players, unless -movetime_ms is set");
+DEFINE_string(mcts_parallel, "tree:tree", "How the MCTS players use "
+              "-search_threads: tree (one tree shared with virtual loss) | "
+              "root (one tree per thread)");
+DEFINE_string(ponder, "0:0", "Keep searching on the opponent's time (the "
+              "AlphaBeta players with a transposition table)");
+DEFINE_string(stats, "", "File where the search statistics of each move are "
+              "written as JSON lines. Use '-' for stdout (the boards and the "
+              "result then go to stderr). Only the Negamax and AlphaBeta "
+              "players count them");
 
 class Game {
  public:
   typedef enum {PLY_HUMAN, PLY_RANDOM, PLY_SIMPLE_NEGAMAX, PLY_SIMPLE_ALPHABETA,
-                PLY_WEIGHT_NEGAMAX, PLY_WEIGHT_ALPHABETA} PlayerType;
+                PLY_WEIGHT_NEGAMAX, PLY_WEIGHT_ALPHABETA, PLY_SOLVER,
+                PLY_MCTS} PlayerType;
   Game() : board_(Board(FLAGS_cols, FLAGS_rows)), curr_player_(0) {
     // Parse AI type from arguments
     std::string player_types_str[2];
@@ -39,6 +64,21 @@ class Game {
     CHECK_EQ(player_wh_[1].size(), 6);
     // Parse Negamax random expansion
     splitStrIntoTwoBool(FLAGS_random, player_random_);
+    // Parse transposition table sizes
+    splitStrIntoTwoSize_t(FLAGS_tt_size, player_tt_size_);
+    // Parse time per move
+    splitStrIntoTwoSize_t(FLAGS_movetime_ms, player_movetime_ms_);
+    // Parse move ordering
+    splitStrIntoTwoBool(FLAGS_move_ordering, player_move_ordering_);
+    // Parse search threads
+    splitStrIntoTwoSize_t(FLAGS_search_threads, player_search_threads_);
+    // Parse opening books
+    splitStrIntoTwoStr(FLAGS_book, player_book_);
+    // Parse pondering
+    splitStrIntoTwoBool(FLAGS_ponder, player_ponder_);
+    // Parse MCTS options
+    splitStrIntoTwoSize_t(FLAGS_playouts, player_playouts_);
+    splitStrIntoTwoStr(FLAGS_mcts_parallel, player_mcts_parallel_);
 
     players_[0] = createPlayer(0, 'O', 'X');
     players_[1] = createPlayer(1, 'X', 'O');
@@ -60,6 +100,10 @@ class Game {
       return Game::PLY_WEIGHT_NEGAMAX;
     } else if (str == "WeightAlphaBeta") {
       return Game::PLY_WEIGHT_ALPHABETA;
+    } else if (str == "Solver") {
+      return Game::PLY_SOLVER;
+    } else if (str == "MCTS") {
+      return Game::PLY_MCTS;
     } else {
       LOG(WARNING) << "Wrong player type: \"" << str << "\". Using Human.";
       return Game::PLY_HUMAN;
@@ -75,11 +119,21 @@ class Game {
       case Game::PLY_SIMPLE_NEGAMAX:
         return new SimpleHeuristic_NegamaxPlayer(player_ids, player_max_depth_[p], player_random_[p]);
       case Game::PLY_SIMPLE_ALPHABETA:
-        return new SimpleHeuristic_NegamaxAlphaBetaPlayer(player_ids, player_max_depth_[p], player_random_[p]);
+        return new SimpleHeuristic_NegamaxAlphaBetaPlayer(player_ids, player_max_depth_[p], player_random_[p], player_tt_size_[p], player_movetime_ms_[p], player_move_ordering_[p], player_search_threads_[p], player_book_[p], player_ponder_[p]);
       case Game::PLY_WEIGHT_NEGAMAX:
         return new WeightHeuristic_NegamaxPlayer(player_ids, player_max_depth_[p], player_wh_[p].data(), player_random_[p]);
       case Game::PLY_WEIGHT_ALPHABETA:
-        return new WeightHeuristic_NegamaxAlphaBetaPlayer(player_ids, player_max_depth_[p], player_wh_[p].data(), player_random_[p]);
+        return new WeightHeuristic_NegamaxAlphaBetaPlayer(player_ids, player_max_depth_[p], player_wh_[p].data(), player_random_[p], player_tt_size_[p], player_movetime_ms_[p], player_move_ordering_[p], player_search_threads_[p], player_book_[p], player_ponder_[p]);
+      case Game::PLY_SOLVER:
+        CHECK(Solver::Supports(FLAGS_cols, FLAGS_rows))
+            << "The Solver does not support " << FLAGS_cols << "x"
+            << FLAGS_rows << " boards";
+        return new SolverPlayer(player_ids, player_tt_size_[p]);
+      case Game::PLY_MCTS:
+        CHECK(player_mcts_parallel_[p] == "tree" ||
+              player_mcts_parallel_[p] == "root")
+            << "Wrong MCTS parallelism: \"" << player_mcts_parallel_[p] << "\"";
+        return new MCTSPlayer(player_ids, player_playouts_[p], player_movetime_ms_[p], player_search_threads_[p], player_mcts_parallel_[p] == "root", player_tt_size_[p]);
       default:
         return NULL;
     }
@@ -90,29 +144,48 @@ class Game {
       of.open(FLAGS_o);
       CHECK(of.is_open()) << "File \"" << FLAGS_o << "\" could not been opened.";
     }
+    std::ofstream sf;
+    if (FLAGS_stats != "" && FLAGS_stats != "-") {
+      sf.open(FLAGS_stats);
+      CHECK(sf.is_open()) << "File \"" << FLAGS_stats << "\" could not been opened.";
+    }
+    std::ostream& stats_os = (FLAGS_stats == "-" ? std::cout : sf);
+    // Keeps stdout for the JSON lines when the statistics go there.
+    std::ostream& out = (FLAGS_stats == "-" ? std::cerr : std::cout);
+    players_[0]->CollectStats(FLAGS_stats != "");
+    players_[1]->CollectStats(FLAGS_stats != "");
+    size_t ply = 0;
     Winner win;
     while (!board_.CheckFull() && win.player == Winner::NONE) {
       Player* curr_player = players_[curr_player_];
       const Player* next_player = players_[(curr_player_ + 1) % 2];
       uint32_t move = curr_player->Move(board_);
       if(!board_.Move(move, curr_player->Id())) {
-        std::cout << "Player " << curr_player->Id() <<
+        out << "Player " << curr_player->Id() <<
             " tried to do a invalid movement ("<< move << "). This is like cheating!"
             " Player " << next_player->Id() << " wins!" << std::endl;
         return;
       }
-      win = board_.CheckWinner();
-      if (FLAGS_o == "") { std::cout << board_ << std::endl; }
+      win = board_.CheckWinnerAt(move);
+      if (FLAGS_stats != "") {
+        stats_os << "{\"ply\":" << ply << ",\"player\":\""
+                 << curr_player->Id() << "\",\"move\":" << move
+                 << ",\"stats\":";
+        curr_player->LastStats().WriteJson(stats_os);
+        stats_os << "}" << std::endl;
+      }
+      ++ply;
+      if (FLAGS_o == "") { out << board_ << std::endl; }
       else { of << board_ << std::endl; }
       curr_player_ = (curr_player_ + 1) % 2;
     }
     of.close();
     if (win.player != Winner::NONE) {
-      std::cout << "Player " << win.player << " wins! Winning cells are "
-                << win.cells[0] << " " << win.cells[1] << " " << win.cells[2]
-                << " " << win.cells[3] << std::endl;
+      out << "Player " << win.player << " wins! Winning cells are "
+          << win.cells[0] << " " << win.cells[1] << " " << win.cells[2]
+          << " " << win.cells[3] << std::endl;
     } else {
-      std::cout << "Players tie!" << std::endl;
+      out << "Players tie!" << std::endl;
     }
   }
  private:
@@ -122,6 +195,14 @@ class Game {
   PlayerType player_type_[2];
   size_t player_max_depth_[2];
   bool player_random_[2];
+  size_t player_tt_size_[2];
+  size_t player_movetime_ms_[2];
+  bool player_move_ordering_[2];
+  size_t player_search_threads_[2];
+  std::string player_book_[2];
+  bool player_ponder_[2];
+  size_t player_playouts_[2];
+  std::string player_mcts_parallel_[2];
   uint8_t curr_player_;
 };
 
@@ -145,6 +226,15 @@ int main(int argc, char** argv) {
   LOG(INFO) << "-max_depth " << FLAGS_max_depth;
   LOG(INFO) << "-wh " << FLAGS_wh;
   LOG(INFO) << "-random " << FLAGS_random;
+  LOG(INFO) << "-tt_size " << FLAGS_tt_size;
+  LOG(INFO) << "-movetime_ms " << FLAGS_movetime_ms;
+  LOG(INFO) << "-move_ordering " << FLAGS_move_ordering;
+  LOG(INFO) << "-search_threads " << FLAGS_search_threads;
+  LOG(INFO) << "-ponder " << FLAGS_ponder;
+  LOG(INFO) << "-playouts " << FLAGS_playouts;
+  LOG(INFO) << "-mcts_parallel " << FLAGS_mcts_parallel;
+  LOG(INFO) << "-book " << FLAGS_book;
+  LOG(INFO) << "-stats " << FLAGS_stats;
   // Play!
   Game game;
   game.Play();
@@ -0,0 +1,397 @@
+#include "BitBoard.hpp"
+#include "Board.hpp"
+#include "Evaluator.hpp"
+#include "Heuristic.hpp"
+#include "MoveOrdering.hpp"
+#include "Negamax.hpp"
+#include "TranspositionTable.hpp"
+#include "Utils.hpp"
+
+#include <glog/logging.h>
+#include <google/gflags.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+std::default_random_engine PRNG;
+
+DEFINE_string(o, "bench.json", "Output JSON filename. Use '-' for stdout "
+              "(the table then goes to stderr) or leave empty to skip it");
+DEFINE_string(baseline, "", "JSON file of a previous run to compare with");
+DEFINE_double(threshold, 0.10, "Relative slowdown (in ns/op) over the "
+              "baseline considered a regression");
+DEFINE_string(filter, "", "Only run the benchmarks whose name contains this");
+DEFINE_uint64(min_time_ms, 200, "Minimum time of each measurement");
+DEFINE_uint64(repetitions, 3, "Measurements of each benchmark. The fastest "
+              "one is reported");
+DEFINE_string(wh, "4;13;121;-10;-31;-128", "Values for weight heuristic");
+
+namespace {
+
+// Fixed set of 7x6 positions (columns played from the empty board, 'O'
+// first), from the opening to the middle game. None of them is over.
+const char* const kPositions[] = {
+  "", "3", "33", "3243", "332211", "3344226", "01234560", "3332221114",
+  "2345432", "33445511",
+};
+
+struct BenchResult {
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  // Nodes per operation (searches only).
+  uint64_t nodes;
+};
+
+// Keeps the compiler from optimizing the measured operations away.
+volatile uint64_t g_sink = 0;
+
+// Time (ns) spent by the measured operation in setup that is not part of
+// what it measures, subtracted from its time.
+double g_untimed_ns = 0.0;
+
+// Calls op(n) with a growing number of iterations n until a call takes
+// -min_time_ms, -repetitions times, and returns the best time per
+// iteration (ns), without g_untimed_ns. op returns the nodes it searched,
+// if any.
+template <class F>
+BenchResult Measure(const std::string& name, const F& op) {
+  BenchResult res = {name, 0, INFINITY, 0};
+  const double min_ns = FLAGS_min_time_ms * 1e6;
+  for (uint64_t rep = 0; rep < std::max<uint64_t>(FLAGS_repetitions, 1);
+       ++rep) {
+    for (uint64_t n = 1;; n *= 2) {
+      g_untimed_ns = 0.0;
+      const std::chrono::steady_clock::time_point t1 =
+          std::chrono::steady_clock::now();
+      const uint64_t nodes = op(n);
+      const double ns = std::chrono::duration<double, std::nano>(
+          std::chrono::steady_clock::now() - t1).count() - g_untimed_ns;
+      if (ns >= min_ns) {
+        if (ns / n < res.ns_per_op) {
+          res.ns_per_op = ns / n;
+          res.iterations = n;
+          res.nodes = nodes / n;
+        }
+        break;
+      }
+    }
+  }
+  return res;
+}
+
+std::vector<Board> Positions() {
+  std::vector<Board> boards;
+  for (size_t i = 0; i < sizeof(kPositions) / sizeof(kPositions[0]); ++i) {
+    Board b(7, 6);
+    for (const char* m = kPositions[i]; *m != '\0'; ++m) {
+      CHECK(b.Move(*m - '0', (m - kPositions[i]) % 2 == 0 ? 'O' : 'X'));
+    }
+    CHECK(b.CheckWinner().player == Winner::NONE && !b.CheckFull())
+        << "Position " << kPositions[i] << " is over";
+    boards.push_back(b);
+  }
+  return boards;
+}
+
+// Player to move in each position.
+uint8_t ToMove(const Board& b) {
+  size_t discs = 0;
+  for (uint16_t c = 0; c < b.Cols(); ++c) { discs += b.Height(c); }
+  return discs % 2 == 0 ? 'O' : 'X';
+}
+
+inline uint8_t Other(const uint8_t p) { return p == 'O' ? 'X' : 'O'; }
+
+// Searches all the positions once per iteration with NegamaxAlphaBeta and,
+// if tt is given, the transposition table, the move ordering and the
+// incremental evaluator, like the AlphaBeta players. The table is cleared
+// before each search, out of the measured time: clearing it costs the same
+// whatever the search does.
+template <class H>
+uint64_t AlphaBetaAll(const std::vector<Board>& boards, const H& h,
+                      const size_t depth, TranspositionTable* tt,
+                      const uint64_t n) {
+  size_t nodes = 0;
+  std::unique_ptr<MoveOrdering> ordering(
+      tt != NULL ? new MoveOrdering(7, 6) : NULL);
+  for (uint64_t it = 0; it < n; ++it) {
+    for (size_t i = 0; i < boards.size(); ++i) {
+      const uint8_t pa = ToMove(boards[i]), pb = Other(pa);
+      SearchContext ctx;
+      std::unique_ptr<Evaluator> eval;
+      if (tt != NULL) {
+        const std::chrono::steady_clock::time_point t1 =
+            std::chrono::steady_clock::now();
+        tt->Clear();
+        g_untimed_ns += std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - t1).count();
+        ordering->NewSearch();
+        eval.reset(h.NewEvaluator(7, 6, pa, pb));
+        if (eval) { eval->Reset(boards[i]); }
+        ctx.tt = tt;
+        ctx.ordering = ordering.get();
+        ctx.eval = eval.get();
+      }
+      g_sink += NegamaxAlphaBeta(BitBoard7x6(boards[i]), pa, pb, depth, h,
+                                 false, -INFINITY, +INFINITY, &nodes,
+                                 &ctx).second;
+    }
+  }
+  return nodes;
+}
+
+template <class H>
+uint64_t NegamaxAll(const std::vector<Board>& boards, const H& h,
+                    const size_t depth, const uint64_t n) {
+  size_t nodes = 0;
+  for (uint64_t it = 0; it < n; ++it) {
+    for (size_t i = 0; i < boards.size(); ++i) {
+      const uint8_t pa = ToMove(boards[i]);
+      g_sink += Negamax(BitBoard7x6(boards[i]), pa, Other(pa), depth, h,
+                        false, &nodes).second;
+    }
+  }
+  return nodes;
+}
+
+// Reads the ns/op of each benchmark of a JSON file written by this program
+// (one benchmark per line).
+std::map<std::string, double> ReadBaseline(const std::string& filename) {
+  std::map<std::string, double> baseline;
+  std::ifstream ifs(filename);
+  CHECK(ifs.is_open()) << "File \"" << filename << "\" could not been opened.";
+  std::string line;
+  while (std::getline(ifs, line)) {
+    const size_t name = line.find("\"name\":\"");
+    const size_t ns = line.find("\"ns_per_op\":");
+    if (name == std::string::npos || ns == std::string::npos) continue;
+    const size_t end = line.find('"', name + 8);
+    if (end == std::string::npos) continue;
+    baseline[line.substr(name + 8, end - name - 8)] =
+        atof(line.c_str() + ns + 12);
+  }
+  return baseline;
+}
+
+void WriteJson(std::ostream& os, const std::vector<BenchResult>& results) {
+  os << std::fixed << std::setprecision(1) << "{\"benchmarks\":[" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    os << "{\"name\":\"" << r.name << "\",\"iterations\":" << r.iterations
+       << ",\"ns_per_op\":" << r.ns_per_op;
+    if (r.nodes > 0) {
+      os << ",\"nodes\":" << r.nodes << ",\"nodes_per_s\":"
+         << r.nodes / (r.ns_per_op * 1e-9);
+    }
+    os << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  os << "]}" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Google tools initialization. The searches log nothing worth seeing
+  // here, so only warnings are logged unless -minloglevel says otherwise.
+  FLAGS_minloglevel = 1;
+  google::InitGoogleLogging(argv[0]);
+  google::SetUsageMessage(
+      "Micro and macro benchmarks of the board, the heuristics and the "
+      "searches");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  std::vector<float> wh;
+  parseFloatList(FLAGS_wh.c_str(), &wh);
+  CHECK_EQ(wh.size(), 6);
+  const SimpleHeuristic simple;
+  const WeightHeuristic weight(wh.data());
+  const std::vector<Board> boards = Positions();
+  std::vector<BitBoard> bitboards;
+  for (size_t i = 0; i < boards.size(); ++i) {
+    bitboards.push_back(BitBoard(boards[i]));
+  }
+  std::vector<std::vector<char> > encoded(boards.size());
+  std::vector<std::pair<char*, size_t> > serialized(boards.size());
+  for (size_t i = 0; i < boards.size(); ++i) {
+    encoded[i].resize(Board::EncodedSize(7, 6));
+    CHECK_GT(boards[i].Encode(encoded[i].data(), encoded[i].size()), 0);
+    boards[i].Serialize(&serialized[i].first, &serialized[i].second);
+  }
+  TranspositionTable tt(16);
+  const size_t num = boards.size();
+
+  std::vector<BenchResult> results;
+  const auto run = [&](const std::string& name, const std::function<
+                       uint64_t(uint64_t)>& op) {
+    if (name.find(FLAGS_filter) == std::string::npos) return;
+    results.push_back(Measure(name, op));
+  };
+  // Micro benchmarks: one operation per position.
+  run("board_move_undo", [&](uint64_t n) {
+      Board b(boards[num - 1]);
+      for (uint64_t i = 0; i < n; ++i) {
+        const uint32_t c = i % 7;
+        if (b.Move(c, 'O')) { b.Undo(c); }
+      }
+      g_sink += b.Hash();
+      return (uint64_t)0;
+    });
+  run("board_expand", [&](uint64_t n) {
+      for (uint64_t i = 0; i < n; ++i) {
+        g_sink += boards[i % num].Expand('O').size();
+      }
+      return (uint64_t)0;
+    });
+  run("board_check_winner", [&](uint64_t n) {
+      for (uint64_t i = 0; i < n; ++i) {
+        g_sink += boards[i % num].CheckWinner().player;
+      }
+      return (uint64_t)0;
+    });
+  run("board_serialize_deserialize", [&](uint64_t n) {
+      Board b(7, 6);
+      for (uint64_t i = 0; i < n; ++i) {
+        char* buff = NULL;
+        size_t size = 0;
+        boards[i % num].Serialize(&buff, &size);
+        g_sink += b.Deserialize(buff, size);
+        delete [] buff;
+      }
+      return (uint64_t)0;
+    });
+  run("board_deserialize", [&](uint64_t n) {
+      Board b(7, 6);
+      for (uint64_t i = 0; i < n; ++i) {
+        g_sink += b.Deserialize(serialized[i % num].first,
+                                serialized[i % num].second);
+      }
+      return (uint64_t)0;
+    });
+  run("board_encode_decode", [&](uint64_t n) {
+      Board b(7, 6);
+      char buff[64];
+      for (uint64_t i = 0; i < n; ++i) {
+        g_sink += b.Decode(buff, boards[i % num].Encode(buff, sizeof(buff)));
+      }
+      return (uint64_t)0;
+    });
+  run("board_decode", [&](uint64_t n) {
+      Board b(7, 6);
+      for (uint64_t i = 0; i < n; ++i) {
+        g_sink += b.Decode(encoded[i % num].data(), encoded[i % num].size());
+      }
+      return (uint64_t)0;
+    });
+  run("bitboard_move_undo", [&](uint64_t n) {
+      BitBoard7x6 b(boards[num - 1]);
+      for (uint64_t i = 0; i < n; ++i) {
+        const uint32_t c = i % 7;
+        if (b.Move(c, 'O')) { b.Undo(c); }
+      }
+      g_sink += b.Hash();
+      return (uint64_t)0;
+    });
+  run("bitboard_wins_at", [&](uint64_t n) {
+      for (uint64_t i = 0; i < n; ++i) {
+        g_sink += bitboards[i % num].WinsAt(i % 7);
+      }
+      return (uint64_t)0;
+    });
+  run("simple_heuristic", [&](uint64_t n) {
+      float s = 0.0f;
+      for (uint64_t i = 0; i < n; ++i) { s += simple(boards[i % num], 'O', 'X'); }
+      g_sink += (uint64_t)s;
+      return (uint64_t)0;
+    });
+  run("weight_heuristic", [&](uint64_t n) {
+      float s = 0.0f;
+      for (uint64_t i = 0; i < n; ++i) { s += weight(boards[i % num], 'O', 'X'); }
+      g_sink += (uint64_t)s;
+      return (uint64_t)0;
+    });
+  run("weight_heuristic_bitboard", [&](uint64_t n) {
+      float s = 0.0f;
+      for (uint64_t i = 0; i < n; ++i) {
+        s += weight(bitboards[i % num], 'O', 'X');
+      }
+      g_sink += (uint64_t)s;
+      return (uint64_t)0;
+    });
+  // Macro benchmarks: one operation searches every position.
+  run("negamax_simple_d4", [&](uint64_t n) {
+      return NegamaxAll(boards, simple, 4, n);
+    });
+  run("negamax_weight_d5", [&](uint64_t n) {
+      return NegamaxAll(boards, weight, 5, n);
+    });
+  run("alphabeta_simple_d7", [&](uint64_t n) {
+      return AlphaBetaAll(boards, simple, 7, NULL, n);
+    });
+  run("alphabeta_weight_d8", [&](uint64_t n) {
+      return AlphaBetaAll(boards, weight, 8, NULL, n);
+    });
+  run("alphabeta_weight_tt_d10", [&](uint64_t n) {
+      return AlphaBetaAll(boards, weight, 10, &tt, n);
+    });
+  for (size_t i = 0; i < serialized.size(); ++i) {
+    delete [] serialized[i].first;
+  }
+
+  std::map<std::string, double> baseline;
+  if (!FLAGS_baseline.empty()) { baseline = ReadBaseline(FLAGS_baseline); }
+  std::ostream& table = (FLAGS_o == "-" ? std::cerr : std::cout);
+  size_t regressions = 0;
+  char line[256];
+  snprintf(line, sizeof(line), "%-28s %12s %14s %14s %10s", "Benchmark",
+           "Iterations", "ns/op", "nodes/s", "Change");
+  table << line << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    std::string change = "";
+    const std::map<std::string, double>::const_iterator b =
+        baseline.find(r.name);
+    if (b != baseline.end() && b->second > 0.0) {
+      const double rel = r.ns_per_op / b->second - 1.0;
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%+.1f%%", 100.0 * rel);
+      change = buf;
+      if (rel > FLAGS_threshold) {
+        change += " !";
+        ++regressions;
+      }
+    }
+    char nps[32] = "";
+    if (r.nodes > 0) {
+      snprintf(nps, sizeof(nps), "%.0f", r.nodes / (r.ns_per_op * 1e-9));
+    }
+    snprintf(line, sizeof(line), "%-28s %12lu %14.1f %14s %10s",
+             r.name.c_str(), (unsigned long)r.iterations, r.ns_per_op, nps,
+             change.c_str());
+    table << line << std::endl;
+  }
+  if (FLAGS_o == "-") {
+    WriteJson(std::cout, results);
+  } else if (!FLAGS_o.empty()) {
+    std::ofstream of(FLAGS_o);
+    CHECK(of.is_open()) << "File \"" << FLAGS_o << "\" could not been opened.";
+    WriteJson(of, results);
+  }
+  if (regressions > 0) {
+    table << regressions << " benchmark(s) more than "
+          << 100.0 * FLAGS_threshold << "% slower than the baseline"
+          << std::endl;
+    return 1;
+  }
+  return 0;
+}
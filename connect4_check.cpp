@@ -0,0 +1,227 @@
+#include "BitBoard.hpp"
+#include "Board.hpp"
+#include "Heuristic.hpp"
+#include "WindowTable.hpp"
+
+#include <glog/logging.h>
+#include <google/gflags.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+std::default_random_engine PRNG;
+
+DEFINE_uint64(positions, 2000, "Random positions checked per board size and "
+              "weight vector");
+DEFINE_uint64(seed, 0, "Random seed");
+DEFINE_uint64(max_errors, 10, "Mismatches printed before the rest are only "
+              "counted");
+
+namespace {
+
+// Board sizes (cols x rows): smaller than a window, the ones that fit in a
+// BitBoard (7x6 and 8x7 are the fixed ones) and larger ones, whose number
+// of windows is not a multiple of the 64 scored per batch.
+const uint16_t kSizes[][2] = {
+  {3, 3}, {4, 4}, {5, 4}, {4, 7}, {7, 6}, {8, 7}, {9, 6}, {6, 8}, {11, 9},
+  {13, 13}, {20, 17}, {31, 5},
+};
+
+const WindowKernel kKernels[] = {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+
+const char* KernelName(const WindowKernel kernel) {
+  switch (kernel) {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE2: return "sse2";
+    case KERNEL_AVX2: return "avx2";
+    default: return "unknown";
+  }
+}
+
+// Bitwise comparison, so that NaN scores compare equal.
+bool SameScore(const float a, const float b) {
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+std::string Hex(const float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  std::ostringstream os;
+  os << f << " (0x" << std::hex << bits << ")";
+  return os.str();
+}
+
+// Weight vectors: the default one, zero, one with fractions far apart in
+// magnitude (so that any change in the order of the additions shows) and
+// random ones.
+std::vector<std::vector<float> > WeightVectors() {
+  std::vector<std::vector<float> > res;
+  res.push_back({4, 13, 121, -10, -31, -128});
+  res.push_back({0, 0, 0, 0, 0, 0});
+  res.push_back({0.1f, 1e-3f, 3e5f, -0.7f, -1e-4f, -2e6f});
+  std::uniform_real_distribution<float> dist(-200.0f, 200.0f);
+  for (size_t i = 0; i < 3; ++i) {
+    std::vector<float> w(6);
+    for (size_t j = 0; j < w.size(); ++j) { w[j] = dist(PRNG); }
+    res.push_back(w);
+  }
+  return res;
+}
+
+struct Checker {
+  size_t checks = 0;
+  size_t errors = 0;
+
+  void Fail(const std::string& what, const Board& b,
+            const std::string& moves, const std::vector<float>& w,
+            const std::string& expected, const std::string& got) {
+    ++errors;
+    if (errors > FLAGS_max_errors) return;
+    std::cerr << "MISMATCH " << what << " on " << b.Cols() << "x" << b.Rows()
+              << ", moves \"" << moves << "\", weights";
+    for (size_t i = 0; i < w.size(); ++i) std::cerr << " " << w[i];
+    std::cerr << ": expected " << expected << ", got " << got << std::endl
+              << b << std::endl;
+  }
+
+  void Score(const std::string& what, const Board& b,
+             const std::string& moves, const std::vector<float>& w,
+             const float expected, const float got) {
+    ++checks;
+    if (!SameScore(expected, got)) {
+      Fail(what, b, moves, w, Hex(expected), Hex(got));
+    }
+  }
+
+  // Compares the window patterns of every kernel and of the BitBoard masks
+  // with the scalar ones, over a random range of windows.
+  void Patterns(const Board& b, const std::string& moves,
+                const std::vector<float>& w, const uint8_t pa,
+                const uint8_t pb) {
+    const WindowTable& t = WindowTable::Get(b.Cols(), b.Rows());
+    if (t.Size() == 0) return;
+    const size_t ncells = b.Cols() * b.Rows();
+    // The SIMD kernels may read up to 3 bytes past the last cell.
+    std::vector<uint8_t> cells(ncells + 3, 0);
+    memcpy(cells.data(), b.Data(), ncells);
+    std::uniform_int_distribution<size_t> dist(0, t.Size());
+    size_t begin = dist(PRNG), end = dist(PRNG);
+    if (begin > end) std::swap(begin, end);
+    std::vector<uint8_t> expected(end - begin + 1), got(end - begin + 1);
+    ComputeWindowPatterns(t, cells.data(), pa, pb, begin, end,
+                          expected.data(), KERNEL_SCALAR);
+    for (size_t k = 1; k < sizeof(kKernels) / sizeof(kKernels[0]); ++k) {
+      if (!WindowKernelSupported(kKernels[k])) continue;
+      ComputeWindowPatterns(t, cells.data(), pa, pb, begin, end, got.data(),
+                            kKernels[k]);
+      ComparePatterns(std::string("patterns ") + KernelName(kKernels[k]), b,
+                      moves, w, begin, end, expected, got);
+    }
+    if (BitBoard::Fits(b.Cols(), b.Rows())) {
+      const BitBoard bb(b);
+      ComputeWindowPatterns(t, bb.Discs(pa), bb.Discs(pb), begin, end,
+                            got.data());
+      ComparePatterns("patterns bitboard", b, moves, w, begin, end, expected,
+                      got);
+    }
+  }
+
+  void ComparePatterns(const std::string& what, const Board& b,
+                       const std::string& moves, const std::vector<float>& w,
+                       const size_t begin, const size_t end,
+                       const std::vector<uint8_t>& expected,
+                       const std::vector<uint8_t>& got) {
+    ++checks;
+    for (size_t i = 0; i < end - begin; ++i) {
+      if (expected[i] != got[i]) {
+        std::ostringstream e, g;
+        e << "window " << begin + i << " = " << int(expected[i]);
+        g << int(got[i]);
+        Fail(what, b, moves, w, e.str(), g.str());
+        return;
+      }
+    }
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::SetUsageMessage(
+      "Checks that the table-driven WeightHeuristic scores are bit-identical "
+      "to the reference implementation");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  PRNG.seed(FLAGS_seed);
+  std::cout << "Kernels:";
+  for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); ++k) {
+    if (WindowKernelSupported(kKernels[k])) {
+      std::cout << " " << KernelName(kKernels[k]);
+    }
+  }
+  std::cout << " (best " << KernelName(BestWindowKernel()) << ")"
+            << std::endl;
+  const std::vector<std::vector<float> > weights = WeightVectors();
+  const uint8_t ids[2] = {'O', 'X'};
+  Checker checker;
+  for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+    const uint16_t cols = kSizes[s][0], rows = kSizes[s][1];
+    const size_t ncells = cols * rows;
+    const size_t checks = checker.checks, errors = checker.errors;
+    for (size_t wi = 0; wi < weights.size(); ++wi) {
+      const std::vector<float>& w = weights[wi];
+      const WeightHeuristic h(w.data());
+      std::uniform_int_distribution<size_t> plies(0, ncells);
+      for (size_t i = 0; i < FLAGS_positions; ++i) {
+        // Random moves, including past a connected four, up to a full
+        // board.
+        Board b(cols, rows);
+        std::ostringstream moves;
+        const size_t n = plies(PRNG);
+        for (size_t p = 0; p < n; ++p) {
+          std::vector<uint16_t> open;
+          for (uint16_t c = 0; c < cols; ++c) {
+            if (b.Height(c) < rows) open.push_back(c);
+          }
+          const uint16_t c = open[PRNG() % open.size()];
+          CHECK(b.Move(c, ids[p % 2]));
+          moves << (p > 0 ? "," : "") << c;
+        }
+        const uint8_t side = PRNG() & 1;
+        const uint8_t pa = ids[side], pb = ids[side ^ 1];
+        const float expected = h.ReferenceScore(b, pa, pb);
+        for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); ++k) {
+          if (!WindowKernelSupported(kKernels[k])) continue;
+          checker.Score(std::string("Board ") + KernelName(kKernels[k]), b,
+                        moves.str(), w, expected,
+                        h.Score(b, pa, pb, kKernels[k]));
+        }
+        checker.Score("Board", b, moves.str(), w, expected, h(b, pa, pb));
+        if (BitBoard::Fits(cols, rows)) {
+          const BitBoard bb(b);
+          checker.Score("BitBoard reference", b, moves.str(), w, expected,
+                        h.ReferenceScore(bb, pa, pb));
+          checker.Score("BitBoard", b, moves.str(), w, expected,
+                        h(bb, pa, pb));
+        }
+        checker.Patterns(b, moves.str(), w, pa, pb);
+      }
+    }
+    std::cout << cols << "x" << rows << ": "
+              << WindowTable::Get(cols, rows).Size() << " windows, "
+              << checker.checks - checks << " checks, "
+              << checker.errors - errors << " mismatches" << std::endl;
+  }
+  if (checker.errors > 0) {
+    std::cout << "FAILED: " << checker.errors << " mismatches in "
+              << checker.checks << " checks" << std::endl;
+    return 1;
+  }
+  std::cout << "OK: " << checker.checks << " checks" << std::endl;
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include "Board.hpp"
+#include "Player.hpp"
+#include "Socket.hpp"
+#include "Zobrist.hpp"
+
+#include <glog/logging.h>
+#include <google/gflags.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+std::default_random_engine PRNG;
+
+DEFINE_string(server, "localhost:4000", "Address of connect4_server: "
+              "host:port or unix:path");
+DEFINE_uint64(connections, 64, "Games played at once, each on its own "
+              "connection");
+DEFINE_uint64(games, 1000, "Total games to play");
+DEFINE_uint64(rows, 6, "Board rows");
+DEFINE_uint64(cols, 7, "Board columns");
+DEFINE_uint64(seed, 0, "Random seed. Each game gets its own seed from it");
+
+namespace {
+
+// Results of the games of a client thread.
+struct ClientStats {
+  uint64_t games;
+  uint64_t wins[3];  // Server, client, draw.
+  uint64_t errors;
+  std::vector<double> latency_ms;
+  ClientStats() : games(0), wins{0, 0, 0}, errors(0) {}
+};
+
+// Plays a game against the server, which moves first in even games, with
+// random moves on the client side. Returns false if the connection failed
+// or the server sent an invalid move.
+bool PlayGame(const uint64_t game, ClientStats* stats) {
+  const int fd = ConnectSocket(FLAGS_server);
+  if (fd < 0) return false;
+  const uint8_t server_id = (game % 2 == 0 ? 'O' : 'X');
+  const uint8_t client_id = (game % 2 == 0 ? 'X' : 'O');
+  const uint8_t server_ids[2] = {server_id, client_id};
+  const uint8_t client_ids[2] = {client_id, server_id};
+  std::default_random_engine rng(Zobrist::Mix(Zobrist::Mix(FLAGS_seed) ^ game));
+  NetworkPlayer server(server_ids, fd);
+  RandomPlayer client(client_ids);
+  client.SetRandomEngine(&rng);
+  Player* players[2] = {&server, &client};
+  Board board(FLAGS_cols, FLAGS_rows);
+  size_t p = (game % 2 == 0 ? 0 : 1);
+  int winner = 2;
+  bool ok = true;
+  for (; !board.CheckFull(); p = 1 - p) {
+    const std::chrono::steady_clock::time_point t1 =
+        std::chrono::steady_clock::now();
+    const uint32_t move = players[p]->Move(board);
+    if (p == 0) {
+      stats->latency_ms.push_back(std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - t1).count());
+    }
+    if (!board.Move(move, players[p]->Id())) {
+      ok = false;
+      break;
+    }
+    if (board.CheckWinnerAt(move).player != Winner::NONE) {
+      winner = p;
+      break;
+    }
+  }
+  close(fd);
+  if (ok) {
+    ++stats->games;
+    ++stats->wins[winner];
+  }
+  return ok;
+}
+
+double Percentile(const std::vector<double>& sorted, const double q) {
+  if (sorted.empty()) return 0.0;
+  return sorted[std::min<size_t>(q * sorted.size(), sorted.size() - 1)];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Google tools initialization. The players log every move, so only
+  // warnings are logged unless -minloglevel says otherwise.
+  FLAGS_minloglevel = 1;
+  google::InitGoogleLogging(argv[0]);
+  google::SetUsageMessage(
+      "Load generator for connect4_server: plays many games at once against "
+      "it and reports the move latencies");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  const size_t num_threads = std::max<uint64_t>(
+      std::min(FLAGS_connections, FLAGS_games), 1);
+  std::atomic<uint64_t> next_game(0);
+  std::vector<ClientStats> stats(num_threads);
+  std::vector<std::thread> threads;
+  const std::chrono::steady_clock::time_point t1 =
+      std::chrono::steady_clock::now();
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.push_back(std::thread([&, i]() {
+          for (uint64_t g = next_game++; g < FLAGS_games; g = next_game++) {
+            if (!PlayGame(g, &stats[i])) { ++stats[i].errors; }
+          }
+        }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) { threads[i].join(); }
+  const double secs = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - t1).count();
+  ClientStats total;
+  for (size_t i = 0; i < stats.size(); ++i) {
+    total.games += stats[i].games;
+    total.errors += stats[i].errors;
+    for (int w = 0; w < 3; ++w) { total.wins[w] += stats[i].wins[w]; }
+    total.latency_ms.insert(total.latency_ms.end(),
+                            stats[i].latency_ms.begin(),
+                            stats[i].latency_ms.end());
+  }
+  std::sort(total.latency_ms.begin(), total.latency_ms.end());
+  double sum = 0.0;
+  for (size_t i = 0; i < total.latency_ms.size(); ++i) {
+    sum += total.latency_ms[i];
+  }
+  std::cout << "Games = " << total.games << " (Server wins = "
+            << total.wins[0] << ", Client wins = " << total.wins[1]
+            << ", Draws = " << total.wins[2] << "), Errors = "
+            << total.errors << std::endl;
+  std::cout << "Moves = " << total.latency_ms.size() << " in " << secs
+            << "s (" << total.latency_ms.size() / secs << "/s)" << std::endl;
+  std::cout << "Latency (ms): Mean = "
+            << (total.latency_ms.empty() ? 0.0 :
+                sum / total.latency_ms.size())
+            << ", p50 = " << Percentile(total.latency_ms, 0.50)
+            << ", p99 = " << Percentile(total.latency_ms, 0.99)
+            << ", Max = " << Percentile(total.latency_ms, 1.0) << std::endl;
+  return total.errors == 0 ? 0 : 1;
+}
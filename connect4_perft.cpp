@@ -0,0 +1,221 @@
+#include "BitBoard.hpp"
+#include "Board.hpp"
+#include "Negamax.hpp"
+
+#include <glog/logging.h>
+#include <google/gflags.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::default_random_engine PRNG;
+
+DEFINE_uint64(rows, 6, "Board rows");
+DEFINE_uint64(cols, 7, "Board columns");
+DEFINE_uint64(depth, 8, "Plies to count");
+DEFINE_string(position, "", "Columns played from the empty board ('O' "
+              "first), e.g. \"3342\". Columns over 9 are not supported");
+DEFINE_string(gen, "move", "How to generate the moves: move (Board::Move and "
+              "Board::WinsAt) | expand (Board::Expand and Board::CheckWinner) "
+              "| bitboard (the representation of the searches)");
+DEFINE_uint64(nthreads, 1, "Num threads. The positions after the first two "
+              "plies are shared among them");
+DEFINE_bool(divide, true, "Print the leaves under each root move");
+
+namespace {
+
+// Leaves at each depth from the empty 7x6 board. A won position is a leaf
+// only at the last ply: it has no moves below.
+const uint64_t kKnown7x6[] = {
+  UINT64_C(1), UINT64_C(7), UINT64_C(49), UINT64_C(343), UINT64_C(2401),
+  UINT64_C(16807), UINT64_C(117649), UINT64_C(823536), UINT64_C(5673234),
+  UINT64_C(39394572), UINT64_C(268031646), UINT64_C(1844590828),
+  UINT64_C(12418296244),
+};
+
+// Counts the leaves depth plies below the board, where ids[side] is to move
+// and nobody has won. nodes counts the moves made.
+template <class B>
+uint64_t Perft(B* b, const uint8_t ids[2], const int side, const size_t depth,
+               uint64_t* nodes) {
+  uint64_t leaves = 0;
+  for (uint16_t c = 0; c < b->Cols(); ++c) {
+    if (b->Height(c) >= b->Rows()) continue;
+    b->Move(c, ids[side]);
+    ++*nodes;
+    if (depth == 1) {
+      ++leaves;
+    } else if (!b->WinsAt(c)) {
+      leaves += Perft(b, ids, side ^ 1, depth - 1, nodes);
+    }
+    b->Undo(c);
+  }
+  return leaves;
+}
+
+uint64_t PerftExpand(const Board& b, const uint8_t ids[2], const int side,
+                     const size_t depth, uint64_t* nodes) {
+  const std::vector<std::pair<uint32_t, Board> > children = b.Expand(ids[side]);
+  *nodes += children.size();
+  if (depth == 1) return children.size();
+  uint64_t leaves = 0;
+  for (size_t i = 0; i < children.size(); ++i) {
+    if (children[i].second.CheckWinner().player == Winner::NONE) {
+      leaves += PerftExpand(children[i].second, ids, side ^ 1, depth - 1,
+                            nodes);
+    }
+  }
+  return leaves;
+}
+
+template <class B>
+uint64_t Leaves(B* b, const uint8_t ids[2], const int side,
+                const size_t depth, uint64_t* nodes) {
+  return Perft(b, ids, side, depth, nodes);
+}
+
+uint64_t Leaves(Board* b, const uint8_t ids[2], const int side,
+                const size_t depth, uint64_t* nodes) {
+  if (FLAGS_gen == "expand") return PerftExpand(*b, ids, side, depth, nodes);
+  return Perft(b, ids, side, depth, nodes);
+}
+
+// The moves of the first split plies that lead to a position to count.
+struct Task {
+  uint16_t moves[2];
+};
+
+struct Result {
+  std::vector<uint64_t> divide;  // Leaves under each root move.
+  uint64_t nodes;
+};
+
+// Counts the leaves under each root move of the board, where ids[side] is
+// to move. The positions split plies below the root are the tasks the
+// threads take in turns.
+struct DivideOn {
+  typedef Result result_type;
+  const uint8_t* ids;
+  int side;
+  size_t depth;
+  size_t split;
+  template <class B>
+  Result operator () (const B& board) const {
+    std::vector<Task> tasks;
+    B b(board);
+    for (uint16_t c0 = 0; c0 < b.Cols(); ++c0) {
+      if (b.Height(c0) >= b.Rows()) continue;
+      b.Move(c0, ids[side]);
+      if (split == 1) {
+        tasks.push_back(Task{{c0, 0}});
+      } else if (!b.WinsAt(c0)) {
+        for (uint16_t c1 = 0; c1 < b.Cols(); ++c1) {
+          if (b.Height(c1) >= b.Rows()) continue;
+          b.Move(c1, ids[side ^ 1]);
+          tasks.push_back(Task{{c0, c1}});
+          b.Undo(c1);
+        }
+      }
+      b.Undo(c0);
+    }
+    std::vector<std::atomic<uint64_t> > divide(b.Cols());
+    for (size_t c = 0; c < divide.size(); ++c) { divide[c] = 0; }
+    // The first plies of the tasks count once, not once per task.
+    std::atomic<uint64_t> nodes(split == 1 ? 0 : Opened(board));
+    std::atomic<size_t> next(0);
+    const auto worker = [&]() {
+      B w(board);
+      uint64_t n = 0;
+      for (size_t t = next++; t < tasks.size(); t = next++) {
+        for (size_t i = 0; i < split; ++i) {
+          w.Move(tasks[t].moves[i], ids[side ^ (i & 1)]);
+        }
+        ++n;
+        uint64_t leaves = 1;
+        if (depth > split) {
+          leaves = (w.WinsAt(tasks[t].moves[split - 1]) ? 0 :
+                    Leaves(&w, ids, side ^ (split & 1), depth - split, &n));
+        }
+        divide[tasks[t].moves[0]] += leaves;
+        for (size_t i = split; i-- > 0;) { w.Undo(tasks[t].moves[i]); }
+      }
+      nodes += n;
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < FLAGS_nthreads; ++i) {
+      threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (size_t i = 0; i < threads.size(); ++i) { threads[i].join(); }
+    Result res;
+    for (size_t c = 0; c < divide.size(); ++c) {
+      res.divide.push_back(divide[c]);
+    }
+    res.nodes = nodes;
+    return res;
+  }
+  template <class B>
+  static uint16_t Opened(const B& b) {
+    uint16_t n = 0;
+    for (uint16_t c = 0; c < b.Cols(); ++c) n += (b.Height(c) < b.Rows());
+    return n;
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::SetUsageMessage(
+      "Counts the positions reached by all the sequences of moves (perft)");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK(FLAGS_gen == "move" || FLAGS_gen == "expand" ||
+        FLAGS_gen == "bitboard") << "Unknown -gen \"" << FLAGS_gen << "\"";
+  CHECK_GT(FLAGS_depth, 0);
+  const uint8_t ids[2] = {'O', 'X'};
+  Board board(FLAGS_cols, FLAGS_rows);
+  for (size_t i = 0; i < FLAGS_position.size(); ++i) {
+    const uint32_t c = FLAGS_position[i] - '0';
+    CHECK(board.Move(c, ids[i % 2]))
+        << "Invalid move " << c << " in -position";
+  }
+  CHECK(board.CheckWinner().player == Winner::NONE && !board.CheckFull())
+      << "The game is over in -position";
+  DivideOn divide_on;
+  divide_on.ids = ids;
+  divide_on.side = FLAGS_position.size() % 2;
+  divide_on.depth = FLAGS_depth;
+  divide_on.split = (FLAGS_nthreads > 1 && FLAGS_depth > 1 ? 2 : 1);
+  const std::chrono::steady_clock::time_point t1 =
+      std::chrono::steady_clock::now();
+  const Result res = (FLAGS_gen == "bitboard" ?
+                      WithSearchBoard(board, divide_on) : divide_on(board));
+  const double secs = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - t1).count();
+  uint64_t leaves = 0;
+  for (size_t c = 0; c < res.divide.size(); ++c) {
+    if (FLAGS_divide && board.Height(c) < board.Rows()) {
+      std::cout << c << ": " << res.divide[c] << std::endl;
+    }
+    leaves += res.divide[c];
+  }
+  std::cout << "Depth = " << FLAGS_depth << ", Leaves = " << leaves
+            << ", Nodes = " << res.nodes << ", Time = " << secs
+            << "sec., Nodes/s = " << res.nodes / secs << std::endl;
+  if (FLAGS_cols == 7 && FLAGS_rows == 6 && FLAGS_position.empty() &&
+      FLAGS_depth < sizeof(kKnown7x6) / sizeof(kKnown7x6[0])) {
+    if (leaves != kKnown7x6[FLAGS_depth]) {
+      std::cout << "MISMATCH: expected " << kKnown7x6[FLAGS_depth]
+                << std::endl;
+      return 1;
+    }
+    std::cout << "OK" << std::endl;
+  }
+  return 0;
+}
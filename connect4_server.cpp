@@ -0,0 +1,527 @@
+#include "Board.hpp"
+#include "Player.hpp"
+#include "Socket.hpp"
+#include "TranspositionTable.hpp"
+#include "Utils.hpp"
+#include "Zobrist.hpp"
+
+#include <glog/logging.h>
+#include <google/gflags.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+std::default_random_engine PRNG;
+
+DEFINE_string(listen, ":4000", "Address to serve games on: host:port (an "
+              "empty host listens on all the interfaces) or unix:path");
+DEFINE_string(ai, "WeightAlphaBeta", "AI of the server. Valid "
+              "intelligences: Random | SimpleNegamax | SimpleAlphaBeta | "
+              "WeightNegamax | WeightAlphaBeta");
+DEFINE_uint64(max_depth, 42, "Max. depth for Minimax algorithm. The "
+              "AlphaBeta AIs usually run out of -movetime_ms first");
+DEFINE_string(wh, "4;13;121;-10;-31;-128", "Values for weight heuristic");
+DEFINE_uint64(movetime_ms, 100, "Time budget per move (ms) of the AlphaBeta "
+              "AIs, counted from the arrival of the request. Use 0 to search "
+              "up to -max_depth");
+DEFINE_uint64(tt_size, 16, "Transposition table size (MB) of each search "
+              "thread of the AlphaBeta AIs, shared by the games it searches. "
+              "Use 0 to disable it");
+DEFINE_bool(move_ordering, true, "Use killer moves, history heuristic and "
+            "center-first move ordering in the AlphaBeta AIs");
+DEFINE_bool(random, false, "Non-deterministic Negamax algorithm");
+DEFINE_uint64(seed, 0, "Random seed. Each connection gets its own seed from "
+              "it");
+DEFINE_uint64(nthreads, 0, "Threads searching moves. Use 0 for one per core");
+DEFINE_uint64(max_connections, 10000, "Connections served at once. Further "
+              "connections are closed right away");
+DEFINE_uint64(max_cells, 1024, "Largest board (cols * rows) accepted");
+DEFINE_uint64(stats_every_s, 10, "Seconds between status lines on stderr. "
+              "Use 0 to disable them");
+
+namespace {
+
+// A client connection. The event loop owns it, except for the player and
+// the board of a move being searched, which only the worker searching it
+// touches until the result is posted back.
+struct Connection {
+  uint64_t id;
+  int fd;
+  bool closed;
+  // Whether a move is being searched. Requests received meanwhile wait in
+  // the input buffer.
+  bool busy;
+  bool want_write;
+  std::string in;
+  std::string out;
+  // Bytes received so far (including the ones already taken from in), and
+  // the total after each read still covering in, with its time, so that
+  // the arrival of each request is known even if it waited in in.
+  uint64_t received_bytes;
+  uint64_t taken_bytes;
+  std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point> >
+      reads;
+  // Board of the last request, decoded in place.
+  Board board;
+  // Created on the first request, once the side of the AI is known, and
+  // again when the side or the board size (player_cols x player_rows)
+  // changes: the players keep state sized for their board.
+  std::unique_ptr<Player> player;
+  uint8_t side;
+  uint16_t player_cols;
+  uint16_t player_rows;
+  std::default_random_engine rng;
+  // Arrival of the request being searched.
+  std::chrono::steady_clock::time_point received;
+  Connection() : received_bytes(0), taken_bytes(0), board(1, 1) {}
+};
+
+struct SearchJob {
+  std::shared_ptr<Connection> conn;
+  uint32_t move;
+};
+
+// Threads searching the moves, so the event loop never waits for a search.
+// Finished jobs are queued back and the loop is woken up through an
+// eventfd. Each thread has a transposition table, which the players of all
+// the games it searches use, so the memory does not grow with the number of
+// connections.
+class SearchPool {
+ public:
+  SearchPool(const size_t num_threads, const int event_fd)
+      : event_fd_(event_fd), quit_(false) {
+    for (size_t i = 0; i < std::max<size_t>(num_threads, 1); ++i) {
+      threads_.push_back(std::thread(&SearchPool::Work, this));
+    }
+  }
+  ~SearchPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+    cv_.notify_all();
+    for (size_t i = 0; i < threads_.size(); ++i) { threads_[i].join(); }
+    for (size_t i = 0; i < pending_.size(); ++i) { delete pending_[i]; }
+    for (size_t i = 0; i < done_.size(); ++i) { delete done_[i]; }
+  }
+  void Submit(SearchJob* job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(job);
+    }
+    cv_.notify_one();
+  }
+  // Takes the finished jobs.
+  void Finished(std::vector<SearchJob*>* jobs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs->assign(done_.begin(), done_.end());
+    done_.clear();
+  }
+ private:
+  const int event_fd_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<SearchJob*> pending_;
+  std::vector<SearchJob*> done_;
+  bool quit_;
+  void Work() {
+    std::unique_ptr<TranspositionTable> tt(
+        FLAGS_tt_size > 0 ? new TranspositionTable(FLAGS_tt_size) : NULL);
+    // The hashes do not include the board size, so the table is cleared
+    // when it changes.
+    uint16_t cols = 0, rows = 0;
+    for (;;) {
+      SearchJob* job = NULL;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return quit_ || !pending_.empty(); });
+        if (quit_) return;
+        job = pending_.front();
+        pending_.pop_front();
+      }
+      Connection* conn = job->conn.get();
+      if (tt && (conn->board.Cols() != cols || conn->board.Rows() != rows)) {
+        tt->Clear();
+        cols = conn->board.Cols();
+        rows = conn->board.Rows();
+      }
+      conn->player->SetTranspositionTable(tt.get());
+      // The time spent in the queue counts towards the budget of the move.
+      conn->player->SetMoveStart(conn->received);
+      job->move = conn->player->Move(conn->board);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.push_back(job);
+      }
+      const uint64_t one = 1;
+      while (write(event_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {}
+    }
+  }
+};
+
+volatile sig_atomic_t g_stop = 0;
+
+void HandleStop(int) { g_stop = 1; }
+
+// The AlphaBeta players are created without a table: they use the one of
+// the search thread.
+Player* CreatePlayer(const uint8_t ids[2], const std::vector<float>& wh) {
+  if (FLAGS_ai == "Random") {
+    return new RandomPlayer(ids);
+  } else if (FLAGS_ai == "SimpleNegamax") {
+    return new SimpleHeuristic_NegamaxPlayer(ids, FLAGS_max_depth,
+                                             FLAGS_random);
+  } else if (FLAGS_ai == "SimpleAlphaBeta") {
+    return new SimpleHeuristic_NegamaxAlphaBetaPlayer(
+        ids, FLAGS_max_depth, FLAGS_random, 0, FLAGS_movetime_ms,
+        FLAGS_move_ordering);
+  } else if (FLAGS_ai == "WeightNegamax") {
+    return new WeightHeuristic_NegamaxPlayer(ids, FLAGS_max_depth, wh.data(),
+                                             FLAGS_random);
+  } else if (FLAGS_ai == "WeightAlphaBeta") {
+    return new WeightHeuristic_NegamaxAlphaBetaPlayer(
+        ids, FLAGS_max_depth, wh.data(), FLAGS_random, 0, FLAGS_movetime_ms,
+        FLAGS_move_ordering);
+  }
+  LOG(FATAL) << "Wrong player type: \"" << FLAGS_ai << "\"";
+  return NULL;
+}
+
+// Reads the board of a request, in the compact wire format of
+// Board::Encode, reusing the memory of the board. Returns the size of the
+// request, 0 if it is not complete yet, or -1 if it is invalid.
+ssize_t ParseRequest(const std::string& in, Board* board) {
+  if (in.size() < Board::kWireHeaderSize) return 0;
+  uint16_t cols = 0, rows = 0;
+  if (!Board::DecodeHeader(in.data(), in.size(), &cols, &rows) ||
+      size_t(cols) * rows > FLAGS_max_cells) {
+    return -1;
+  }
+  if (in.size() < Board::EncodedSize(cols, rows)) return 0;
+  const size_t size = board->Decode(in.data(), in.size());
+  return size > 0 ? size : -1;
+}
+
+// Side to move: 'O' plays first, so it moves whenever both players have the
+// same number of discs. Returns 0 if the disc counts are not possible or
+// there are discs of other players.
+uint8_t SideToMove(const Board& b) {
+  size_t n[2] = {0, 0};
+  for (uint16_t c = 0; c < b.Cols(); ++c) {
+    for (uint16_t r = 0; r < b.Height(c); ++r) {
+      const uint8_t p = b.Get(c, r);
+      if (p != 'O' && p != 'X') return 0;
+      ++n[p == 'O' ? 0 : 1];
+    }
+  }
+  if (n[0] == n[1]) return 'O';
+  if (n[0] == n[1] + 1) return 'X';
+  return 0;
+}
+
+class Server {
+ public:
+  Server(const int listen_fd, const size_t num_threads)
+      : listen_fd_(listen_fd), epoll_fd_(epoll_create1(0)),
+        event_fd_(eventfd(0, EFD_NONBLOCK)), next_id_(1),
+        max_input_(MaxInput()), moves_(0), latency_ms_(0.0),
+        max_latency_ms_(0.0) {
+    CHECK_GE(epoll_fd_, 0) << strerror(errno);
+    CHECK_GE(event_fd_, 0) << strerror(errno);
+    parseFloatList(FLAGS_wh.c_str(), &wh_);
+    CHECK_EQ(wh_.size(), 6);
+    pool_.reset(new SearchPool(num_threads, event_fd_));
+    CHECK(SetNonBlocking(listen_fd_));
+    Watch(listen_fd_, EPOLLIN, 0);
+    // Connection ids start at 1, so 0 can stand for the listening socket
+    // and ~0 for the eventfd.
+    Watch(event_fd_, EPOLLIN, ~UINT64_C(0));
+  }
+  ~Server() {
+    // The workers write to the eventfd, so they must be gone before it is
+    // closed.
+    pool_.reset();
+    close(epoll_fd_);
+    close(event_fd_);
+  }
+  void Run() {
+    std::vector<epoll_event> events(256);
+    std::chrono::steady_clock::time_point last_stats =
+        std::chrono::steady_clock::now();
+    uint64_t last_moves = 0;
+    while (!g_stop) {
+      const int n = epoll_wait(epoll_fd_, events.data(), events.size(), 1000);
+      CHECK(n >= 0 || errno == EINTR) << "epoll_wait: " << strerror(errno);
+      for (int i = 0; i < n; ++i) {
+        const uint64_t id = events[i].data.u64;
+        if (id == 0) {
+          Accept();
+        } else if (id == ~UINT64_C(0)) {
+          Finish();
+        } else {
+          std::unordered_map<uint64_t, std::shared_ptr<Connection> >::iterator
+              it = conns_.find(id);
+          if (it != conns_.end()) { Handle(it->second, events[i].events); }
+        }
+      }
+      const std::chrono::steady_clock::time_point now =
+          std::chrono::steady_clock::now();
+      const double elapsed =
+          std::chrono::duration<double>(now - last_stats).count();
+      if (FLAGS_stats_every_s > 0 && elapsed >= FLAGS_stats_every_s) {
+        std::cerr << "Connections = " << conns_.size() << ", Moves = "
+                  << moves_ << " (" << (moves_ - last_moves) / elapsed
+                  << "/s), Mean latency = "
+                  << (moves_ > 0 ? latency_ms_ / moves_ : 0.0)
+                  << "ms, Max latency = " << max_latency_ms_ << "ms"
+                  << std::endl;
+        last_stats = now;
+        last_moves = moves_;
+      }
+    }
+    // Searches in progress keep their connection alive until they finish.
+    while (!conns_.empty()) { Close(conns_.begin()->second); }
+  }
+ private:
+  const int listen_fd_;
+  const int epoll_fd_;
+  const int event_fd_;
+  uint64_t next_id_;
+  // Largest input buffer of a connection.
+  const size_t max_input_;
+  std::unordered_map<uint64_t, std::shared_ptr<Connection> > conns_;
+  std::vector<float> wh_;
+  uint64_t moves_;
+  double latency_ms_;
+  double max_latency_ms_;
+  std::unique_ptr<SearchPool> pool_;
+
+  // Size of the largest valid request (a single row of -max_cells columns)
+  // times a few, so that clients can send their next request before the
+  // answer to the last one.
+  static size_t MaxInput() {
+    const uint16_t cols = std::min<uint64_t>(std::max<uint64_t>(
+        FLAGS_max_cells, 1), UINT16_MAX);
+    return 4 * Board::EncodedSize(cols, 1);
+  }
+
+  void Watch(const int fd, const uint32_t events, const uint64_t id) {
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = id;
+    CHECK_EQ(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev), 0)
+        << strerror(errno);
+  }
+
+  void Accept() {
+    for (;;) {
+      const int fd = accept(listen_fd_, NULL, NULL);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          LOG(WARNING) << "accept: " << strerror(errno);
+        }
+        return;
+      }
+      if (conns_.size() >= FLAGS_max_connections || !SetNonBlocking(fd)) {
+        close(fd);
+        continue;
+      }
+      std::shared_ptr<Connection> conn(new Connection);
+      conn->id = next_id_++;
+      conn->fd = fd;
+      conn->closed = false;
+      conn->busy = false;
+      conn->want_write = false;
+      conn->side = 0;
+      conn->player_cols = 0;
+      conn->player_rows = 0;
+      conn->rng.seed(Zobrist::Mix(Zobrist::Mix(FLAGS_seed) ^ conn->id));
+      conns_[conn->id] = conn;
+      Watch(fd, EPOLLIN, conn->id);
+    }
+  }
+
+  void Close(const std::shared_ptr<Connection>& conn) {
+    if (conn->closed) return;
+    conn->closed = true;
+    close(conn->fd);
+    conns_.erase(conn->id);
+  }
+
+  void Handle(const std::shared_ptr<Connection>& conn, const uint32_t events) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+      Close(conn);
+      return;
+    }
+    if (events & EPOLLOUT) {
+      Flush(conn);
+      if (conn->closed) return;
+    }
+    if (events & EPOLLIN) {
+      char buf[4096];
+      const uint64_t before = conn->received_bytes;
+      for (;;) {
+        const ssize_t r = recv(conn->fd, buf, sizeof(buf), 0);
+        if (r > 0) {
+          conn->in.append(buf, r);
+          conn->received_bytes += r;
+          if (conn->in.size() > max_input_) {
+            LOG(WARNING) << "Closing connection " << conn->id
+                         << ": Over " << max_input_ << " bytes pending";
+            Close(conn);
+            return;
+          }
+          continue;
+        }
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        Close(conn);
+        return;
+      }
+      if (conn->received_bytes > before) {
+        conn->reads.push_back(std::make_pair(
+            conn->received_bytes, std::chrono::steady_clock::now()));
+      }
+      Process(conn);
+    }
+  }
+
+  // Starts the search of the next request of the connection, if it is
+  // complete and no other search of the connection is running.
+  void Process(const std::shared_ptr<Connection>& conn) {
+    if (conn->busy || conn->closed) return;
+    Board& board = conn->board;
+    const ssize_t size = ParseRequest(conn->in, &board);
+    if (size == 0) return;
+    const uint8_t side = (size > 0 ? SideToMove(board) : 0);
+    if (side == 0 || board.CheckFull() ||
+        board.CheckWinner().player != Winner::NONE) {
+      LOG(WARNING) << "Closing connection " << conn->id
+                   << ": Invalid request";
+      Close(conn);
+      return;
+    }
+    conn->in.erase(0, size);
+    // The request arrived with the first read reaching its end.
+    conn->taken_bytes += size;
+    while (conn->reads.front().first < conn->taken_bytes) {
+      conn->reads.pop_front();
+    }
+    conn->received = conn->reads.front().second;
+    if (conn->reads.front().first == conn->taken_bytes) {
+      conn->reads.pop_front();
+    }
+    if (!conn->player || conn->side != side ||
+        conn->player_cols != board.Cols() ||
+        conn->player_rows != board.Rows()) {
+      const uint8_t ids[2] = {side, (uint8_t)(side == 'O' ? 'X' : 'O')};
+      conn->player.reset(CreatePlayer(ids, wh_));
+      conn->player->SetRandomEngine(&conn->rng);
+      conn->side = side;
+      conn->player_cols = board.Cols();
+      conn->player_rows = board.Rows();
+    }
+    conn->busy = true;
+    SearchJob* job = new SearchJob{conn, 0};
+    pool_->Submit(job);
+  }
+
+  void Finish() {
+    uint64_t count = 0;
+    while (read(event_fd_, &count, sizeof(count)) < 0 && errno == EINTR) {}
+    std::vector<SearchJob*> jobs;
+    pool_->Finished(&jobs);
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      std::unique_ptr<SearchJob> job(jobs[i]);
+      const std::shared_ptr<Connection>& conn = job->conn;
+      conn->busy = false;
+      if (conn->closed) continue;
+      const double ms = std::chrono::duration<double, std::milli>(
+          now - conn->received).count();
+      ++moves_;
+      latency_ms_ += ms;
+      max_latency_ms_ = std::max(max_latency_ms_, ms);
+      conn->out.append((const char*)&job->move, sizeof(job->move));
+      Flush(conn);
+      Process(conn);
+    }
+  }
+
+  void Flush(const std::shared_ptr<Connection>& conn) {
+    while (!conn->out.empty()) {
+      const ssize_t w = send(conn->fd, conn->out.data(), conn->out.size(),
+                             MSG_NOSIGNAL);
+      if (w > 0) {
+        conn->out.erase(0, w);
+        continue;
+      }
+      if (w < 0 && errno == EINTR) continue;
+      if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      Close(conn);
+      return;
+    }
+    const bool want_write = !conn->out.empty();
+    if (want_write != conn->want_write) {
+      epoll_event ev;
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+      ev.data.u64 = conn->id;
+      CHECK_EQ(epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->fd, &ev), 0)
+          << strerror(errno);
+      conn->want_write = want_write;
+    }
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Google tools initialization. The players log every move, so only
+  // warnings are logged unless -minloglevel says otherwise.
+  FLAGS_minloglevel = 1;
+  google::InitGoogleLogging(argv[0]);
+  google::SetUsageMessage(
+      "Serves Connect Four games against an AI to many clients at once");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  PRNG.seed(FLAGS_seed);
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, HandleStop);
+  signal(SIGTERM, HandleStop);
+  const int fd = ListenSocket(FLAGS_listen);
+  CHECK_GE(fd, 0) << "Could not listen on \"" << FLAGS_listen << "\": "
+                  << strerror(errno);
+  const size_t threads = FLAGS_nthreads > 0 ? FLAGS_nthreads :
+      std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  std::cerr << "Serving " << FLAGS_ai << " on " << FLAGS_listen << " with "
+            << threads << " search threads" << std::endl;
+  {
+    Server server(fd, threads);
+    server.Run();
+  }
+  close(fd);
+  const std::string path = UnixSocketPath(FLAGS_listen);
+  if (!path.empty()) { unlink(path.c_str()); }
+  return 0;
+}
@@ -0,0 +1,290 @@
+#include "Board.hpp"
+#include "Player.hpp"
+#include "Utils.hpp"
+#include "Zobrist.hpp"
+
+#include <glog/logging.h>
+#include <google/gflags.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::default_random_engine PRNG;
+
+DEFINE_string(o, "-", "Output filename. Use '-' for stdout");
+DEFINE_string(format, "csv", "Output format: csv | json");
+DEFINE_uint64(rows, 6, "Board rows");
+DEFINE_uint64(cols, 7, "Board columns");
+DEFINE_uint64(seed, 0, "Random seed. Each game gets its own seed from it, "
+              "so results do not depend on -nthreads");
+DEFINE_uint64(games, 500, "Games per pairing");
+DEFINE_uint64(nthreads, 1, "Num threads");
+DEFINE_string(players, "RND=Random,Simple=SimpleAlphaBeta,"
+              "WHeur1=WeightAlphaBeta/1;10;100;-2;-20;-200,"
+              "WHeur2=WeightAlphaBeta/4;13;121;-10;-31;-128",
+              "Comma-separated players, as name=ai or name=ai/weights. Valid "
+              "intelligences: Random | SimpleNegamax | SimpleAlphaBeta | "
+              "WeightNegamax | WeightAlphaBeta | Solver");
+DEFINE_string(pairs, "", "Comma-separated pairings, as first:second player "
+              "names. Leave empty to play every ordered pair (including a "
+              "player against itself)");
+DEFINE_uint64(max_depth, 5, "Max. depth for Minimax algorithm");
+DEFINE_bool(random, true, "Non-deterministic Negamax algorithm");
+DEFINE_uint64(tt_size, 16, "Transposition table size (MB) for the AlphaBeta "
+              "players. Use 0 to disable it");
+DEFINE_uint64(movetime_ms, 0, "Time per move (ms) for the AlphaBeta players, "
+              "using iterative deepening up to -max_depth. Use 0 to search "
+              "-max_depth plies");
+DEFINE_bool(move_ordering, true, "Use killer moves, history heuristic and "
+            "center-first move ordering in the AlphaBeta players");
+
+struct PlayerSpec {
+  std::string name;
+  std::string ai;
+  std::vector<float> weights;
+};
+
+// Sums of a sample, to report its mean with a 95% confidence interval.
+struct Stat {
+  double n, sum, sum2;
+  Stat() : n(0), sum(0), sum2(0) {}
+  inline void Add(const double x) { n += 1; sum += x; sum2 += x * x; }
+  inline void Add(const Stat& o) { n += o.n; sum += o.sum; sum2 += o.sum2; }
+  inline double Mean() const { return n > 0 ? sum / n : 0.0; }
+  inline double Ci() const {
+    if (n == 0) return 0.0;
+    const double m = Mean();
+    return 1.96 * sqrt(std::max(sum2 / n - m * m, 0.0)) / sqrt(n);
+  }
+};
+
+// Result of a game: the winner (0 for the first player, 1 for the second,
+// 2 for a draw) and the nodes and time (ms) of each move of each player.
+struct GameResult {
+  int winner;
+  Stat nodes[2];
+  Stat ms[2];
+};
+
+static PlayerSpec ParsePlayerSpec(const std::string& str) {
+  PlayerSpec spec;
+  const size_t eq = str.find('=');
+  CHECK_NE(eq, std::string::npos) << "Bad player \"" << str
+                                  << "\". Expected format: name=ai[/weights]";
+  spec.name = str.substr(0, eq);
+  const size_t sl = str.find('/', eq);
+  spec.ai = str.substr(eq + 1, sl == std::string::npos ?
+                       std::string::npos : sl - eq - 1);
+  if (sl != std::string::npos) {
+    parseFloatList(str.c_str() + sl + 1, &spec.weights);
+  } else {
+    spec.weights.assign(6, 0.0f);
+  }
+  CHECK_EQ(spec.weights.size(), 6) << "Bad weights of player " << spec.name;
+  return spec;
+}
+
+static std::vector<std::string> SplitList(const std::string& str) {
+  std::vector<std::string> items;
+  std::istringstream iss(str);
+  std::string item;
+  while (std::getline(iss, item, ',')) {
+    if (!item.empty()) { items.push_back(item); }
+  }
+  return items;
+}
+
+static Player* CreatePlayer(const PlayerSpec& spec, const uint8_t ids[2]) {
+  if (spec.ai == "Random") {
+    return new RandomPlayer(ids);
+  } else if (spec.ai == "SimpleNegamax") {
+    return new SimpleHeuristic_NegamaxPlayer(ids, FLAGS_max_depth,
+                                             FLAGS_random);
+  } else if (spec.ai == "SimpleAlphaBeta") {
+    return new SimpleHeuristic_NegamaxAlphaBetaPlayer(
+        ids, FLAGS_max_depth, FLAGS_random, FLAGS_tt_size, FLAGS_movetime_ms,
+        FLAGS_move_ordering);
+  } else if (spec.ai == "WeightNegamax") {
+    return new WeightHeuristic_NegamaxPlayer(ids, FLAGS_max_depth,
+                                             spec.weights.data(), FLAGS_random);
+  } else if (spec.ai == "WeightAlphaBeta") {
+    return new WeightHeuristic_NegamaxAlphaBetaPlayer(
+        ids, FLAGS_max_depth, spec.weights.data(), FLAGS_random,
+        FLAGS_tt_size, FLAGS_movetime_ms, FLAGS_move_ordering);
+  } else if (spec.ai == "Solver") {
+    return new SolverPlayer(ids, FLAGS_tt_size);
+  }
+  LOG(FATAL) << "Wrong player type: \"" << spec.ai << "\"";
+  return NULL;
+}
+
+// Plays a game between fresh players, with all their random numbers drawn
+// from an engine seeded with seed. As in connect4, an invalid move loses.
+static GameResult PlayGame(const PlayerSpec& a, const PlayerSpec& b,
+                           const uint64_t seed) {
+  const uint8_t ids[2][2] = {{'O', 'X'}, {'X', 'O'}};
+  std::default_random_engine rng(seed);
+  std::unique_ptr<Player> players[2] = {
+    std::unique_ptr<Player>(CreatePlayer(a, ids[0])),
+    std::unique_ptr<Player>(CreatePlayer(b, ids[1]))};
+  players[0]->SetRandomEngine(&rng);
+  players[1]->SetRandomEngine(&rng);
+  Board board(FLAGS_cols, FLAGS_rows);
+  GameResult res;
+  res.winner = 2;
+  for (size_t p = 0; !board.CheckFull(); p = 1 - p) {
+    const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    const uint32_t move = players[p]->Move(board);
+    const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double, std::milli> ts = t2 - t1;
+    res.nodes[p].Add(players[p]->LastNodes());
+    res.ms[p].Add(ts.count());
+    if (!board.Move(move, ids[p][0])) {
+      res.winner = 1 - p;
+      break;
+    }
+    if (board.CheckWinnerAt(move).player != Winner::NONE) {
+      res.winner = p;
+      break;
+    }
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  // Google tools initialization. The players log every move, so only
+  // warnings are logged unless -minloglevel says otherwise.
+  FLAGS_minloglevel = 1;
+  google::InitGoogleLogging(argv[0]);
+  google::SetUsageMessage("Plays Connect Four tournaments between AIs");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK(FLAGS_format == "csv" || FLAGS_format == "json")
+      << "Wrong format: \"" << FLAGS_format << "\"";
+  // Parse players and pairings
+  std::vector<PlayerSpec> specs;
+  const std::vector<std::string> items = SplitList(FLAGS_players);
+  for (size_t i = 0; i < items.size(); ++i) {
+    specs.push_back(ParsePlayerSpec(items[i]));
+  }
+  CHECK(!specs.empty()) << "No players given";
+  std::vector<std::pair<size_t, size_t> > pairs;
+  if (FLAGS_pairs.empty()) {
+    for (size_t i = 0; i < specs.size(); ++i) {
+      for (size_t j = 0; j < specs.size(); ++j) {
+        pairs.push_back(std::make_pair(i, j));
+      }
+    }
+  } else {
+    const std::vector<std::string> ps = SplitList(FLAGS_pairs);
+    for (size_t k = 0; k < ps.size(); ++k) {
+      std::string names[2];
+      splitStrIntoTwoStr(ps[k], names);
+      size_t idx[2] = {specs.size(), specs.size()};
+      for (size_t i = 0; i < specs.size(); ++i) {
+        if (specs[i].name == names[0]) { idx[0] = i; }
+        if (specs[i].name == names[1]) { idx[1] = i; }
+      }
+      CHECK(idx[0] < specs.size() && idx[1] < specs.size())
+          << "Unknown player in pairing \"" << ps[k] << "\"";
+      pairs.push_back(std::make_pair(idx[0], idx[1]));
+    }
+  }
+
+  // Play all the games
+  const size_t num_games = pairs.size() * FLAGS_games;
+  std::vector<GameResult> results(num_games);
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < std::max<uint64_t>(FLAGS_nthreads, 1); ++t) {
+    threads.push_back(std::thread([&]() {
+          for (size_t g = next++; g < num_games; g = next++) {
+            const std::pair<size_t, size_t>& pr = pairs[g / FLAGS_games];
+            const uint64_t seed = Zobrist::Mix(Zobrist::Mix(FLAGS_seed) ^ g);
+            results[g] = PlayGame(specs[pr.first], specs[pr.second], seed);
+          }
+        }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  const std::chrono::duration<float> ts = t2 - t1;
+  std::cerr << "Games = " << num_games << ", Time = " << ts.count() << "sec."
+            << std::endl;
+
+  // Report each pairing
+  std::ofstream of;
+  if (FLAGS_o != "-") {
+    of.open(FLAGS_o);
+    CHECK(of.is_open()) << "File \"" << FLAGS_o << "\" could not been opened.";
+  }
+  std::ostream& os = FLAGS_o != "-" ? of : std::cout;
+  const char* outcomes[3] = {"first_wins", "second_wins", "draws"};
+  const char* sides[2] = {"first", "second"};
+  if (FLAGS_format == "csv") {
+    os << "first,second,games";
+    for (int k = 0; k < 3; ++k) {
+      os << "," << outcomes[k] << "," << outcomes[k] << "_ci";
+    }
+    for (int p = 0; p < 2; ++p) {
+      os << "," << sides[p] << "_moves," << sides[p] << "_nodes,"
+         << sides[p] << "_nodes_ci," << sides[p] << "_ms," << sides[p]
+         << "_ms_ci";
+    }
+    os << std::endl;
+  } else {
+    os << "[" << std::endl;
+  }
+  for (size_t k = 0; k < pairs.size(); ++k) {
+    Stat outcome[3], nodes[2], ms[2];
+    for (size_t g = k * FLAGS_games; g < (k + 1) * FLAGS_games; ++g) {
+      for (int w = 0; w < 3; ++w) { outcome[w].Add(results[g].winner == w); }
+      for (int p = 0; p < 2; ++p) {
+        nodes[p].Add(results[g].nodes[p]);
+        ms[p].Add(results[g].ms[p]);
+      }
+    }
+    const std::string& first = specs[pairs[k].first].name;
+    const std::string& second = specs[pairs[k].second].name;
+    if (FLAGS_format == "csv") {
+      os << first << "," << second << "," << FLAGS_games;
+      for (int w = 0; w < 3; ++w) {
+        os << "," << outcome[w].Mean() << "," << outcome[w].Ci();
+      }
+      for (int p = 0; p < 2; ++p) {
+        os << "," << (size_t)nodes[p].n << "," << nodes[p].Mean() << ","
+           << nodes[p].Ci() << "," << ms[p].Mean() << "," << ms[p].Ci();
+      }
+      os << std::endl;
+    } else {
+      os << "  {\"first\": \"" << first << "\", \"second\": \"" << second
+         << "\", \"games\": " << FLAGS_games;
+      for (int w = 0; w < 3; ++w) {
+        os << ", \"" << outcomes[w] << "\": " << outcome[w].Mean() << ", \""
+           << outcomes[w] << "_ci\": " << outcome[w].Ci();
+      }
+      for (int p = 0; p < 2; ++p) {
+        os << ", \"" << sides[p] << "_moves\": " << (size_t)nodes[p].n << ", \""
+           << sides[p] << "_nodes\": " << nodes[p].Mean() << ", \""
+           << sides[p] << "_nodes_ci\": " << nodes[p].Ci() << ", \""
+           << sides[p] << "_ms\": " << ms[p].Mean() << ", \"" << sides[p]
+           << "_ms_ci\": " << ms[p].Ci();
+      }
+      os << "}" << (k + 1 < pairs.size() ? "," : "") << std::endl;
+    }
+  }
+  if (FLAGS_format == "json") { os << "]" << std::endl; }
+  return 0;
+}
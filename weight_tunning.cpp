@@ -1,16 +1,23 @@
+#include <fcntl.h>
 #include <glog/logging.h>
 #include <google/gflags.h>
+#include <string.h>
+#include <unistd.h>
 #include <algorithm>
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
 
 #include "Board.hpp"
+#include "GameCache.hpp"
+#include "GameWorkers.hpp"
 #include "Player.hpp"
 #include "Utils.hpp"
-
-#include <thread>
-#include <future>
+#include "WorkStealingPool.hpp"
+#include "Zobrist.hpp"
 
 typedef int16_t Wtype;
 
@@ -27,6 +34,25 @@ DEFINE_uint64(nthreads, 1, "Num threads");
 DEFINE_uint64(rows, 6, "Board rows");
 DEFINE_uint64(cols, 7, "Board columns");
 DEFINE_bool(random, true, "Non-deterministic Negamax algorithm");
+DEFINE_string(game_cache, "", "File keeping the results of the games between "
+              "runs. Only used with -random false, when games are cached. A "
+              "file written with other game settings or by another engine "
+              "version is refused");
+DEFINE_string(checkpoint, "", "File where the state of the run is saved "
+              "every -checkpoint_every generations");
+DEFINE_uint64(checkpoint_every, 1, "Generations between checkpoints");
+DEFINE_bool(resume, false, "Continue the run saved in -checkpoint");
+DEFINE_string(listen, "", "Address (host:port or unix:path) where workers "
+              "connect to play the games. Empty plays them on this process");
+DEFINE_uint64(batch_size, 16, "Games sent at once to each worker thread");
+DEFINE_uint64(batch_timeout_s, 600, "Seconds the coordinator waits for the "
+              "results of a batch before sending it to another worker");
+DEFINE_uint64(worker_wait_s, 600, "Seconds the coordinator waits for a "
+              "worker to connect when none is, before giving up");
+DEFINE_bool(worker, false, "Play the games of the coordinator at "
+            "-coordinator instead of running the search");
+DEFINE_string(coordinator, "", "Address (host:port or unix:path) of the "
+              "coordinator, for -worker");
 
 struct Badness {
   int lost;
@@ -121,6 +147,10 @@ class Individual {
   const Wtype* Weights() const {
     return w;
   }
+  void SetWeights(const Wtype* weights) {
+    std::copy(weights, weights + 6, w);
+    ComputeLength();
+  }
  private:
   Wtype w[6];
   float l;
@@ -133,32 +163,199 @@ class Individual {
   }
 };
 
+// Settings of the players of PlayGame besides the weights and the depth
+// (which are part of the keys of the cached games).
+static const size_t kGameTTSizeMB = 0;
+static const size_t kGameMoveTimeMs = 0;
+static const bool kGameMoveOrdering = false;
+// Bump whenever a change of the search or the heuristics changes the games
+// played with the same settings, so that older cached games are not used.
+static const uint32_t kGameEngineVersion = 1;
+
+// Identifies the settings above in the game cache.
+static uint64_t GameSettings() {
+  uint64_t h = Zobrist::Mix(kGameEngineVersion);
+  h = Zobrist::Mix(h ^ kGameTTSizeMB);
+  h = Zobrist::Mix(h ^ kGameMoveTimeMs);
+  return Zobrist::Mix(h ^ kGameMoveOrdering);
+}
+
+// Plays a game with all the random numbers drawn from an engine seeded with
+// seed, so that games can run at once on several threads reproducibly.
 void PlayGame(const Wtype wa[6], const Wtype wb[6], const uint16_t cols,
-              const uint16_t rows, int* winner, int* round) {
+              const uint16_t rows, const uint32_t depth, const bool random,
+              const uint64_t seed, int* winner, int* round) {
   Board board(cols, rows);
   uint8_t ids[2][2] = {{'O','X'},{'X','O'}};
   const float waf[6] = {(float)wa[0], (float)wa[1], (float)wa[2], (float)wa[3], (float)wa[4], (float)wa[5]};
   const float wbf[6] = {(float)wb[0], (float)wb[1], (float)wb[2], (float)wb[3], (float)wb[4], (float)wb[5]};
   WeightHeuristic_NegamaxAlphaBetaPlayer players[2] = {
-    WeightHeuristic_NegamaxAlphaBetaPlayer(ids[0], FLAGS_max_depth, waf, FLAGS_random),
-    WeightHeuristic_NegamaxAlphaBetaPlayer(ids[1], FLAGS_max_depth, wbf, FLAGS_random)};
+    {ids[0], depth, waf, random, kGameTTSizeMB, kGameMoveTimeMs,
+     kGameMoveOrdering},
+    {ids[1], depth, wbf, random, kGameTTSizeMB, kGameMoveTimeMs,
+     kGameMoveOrdering}};
+  std::default_random_engine rng(seed);
+  players[0].SetRandomEngine(&rng);
+  players[1].SetRandomEngine(&rng);
   *round = 0;
   *winner = 0;
   size_t curr_player = 0;
   for (; !board.CheckFull(); ++(*round), curr_player = (curr_player + 1) % 2) {
-    CHECK(board.Move(players[curr_player].Move(board), players[curr_player].Id()));
-    Winner win = board.CheckWinner();
+    const uint32_t move = players[curr_player].Move(board);
+    CHECK(board.Move(move, players[curr_player].Id()));
+    Winner win = board.CheckWinnerAt(move);
     if (win.player == 'O') { *winner = -1; break; }
     else if (win.player == 'X') { *winner = 1; break; }
   }
 }
 
+void PlayGameJob(const GameJob& job, GameJobResult* result) {
+  int winner = 0, rounds = 0;
+  PlayGame(job.wa, job.wb, job.cols, job.rows, job.depth, job.random,
+           job.seed, &winner, &rounds);
+  result->id = job.id;
+  result->winner = winner;
+  result->rounds = rounds;
+}
+
+static GameCache::Key CacheKey(const GameJob& job) {
+  GameCache::Key key;
+  std::copy(job.wa, job.wa + 6, key.wa);
+  std::copy(job.wb, job.wb + 6, key.wb);
+  key.cols = job.cols;
+  key.rows = job.rows;
+  key.depth = job.depth;
+  return key;
+}
+
+typedef std::vector<std::pair<Badness, Individual> > Population;
+
+static const char kCheckpointMagic[8] = {'C', '4', 'T', 'U', 'N', 'E', '0', '1'};
+
+// Settings a checkpoint must be resumed with.
+struct CheckpointHeader {
+  char magic[8];
+  uint64_t generation;
+  uint64_t population;
+  uint64_t nbest;
+  uint64_t cols;
+  uint64_t rows;
+  uint64_t max_depth;
+  uint64_t random;
+};
+
+static void WriteIndividuals(std::ostream& os, const Population& pop) {
+  for (size_t i = 0; i < pop.size(); ++i) {
+    const int32_t b[2] = {pop[i].first.lost, pop[i].first.rounds};
+    os.write((const char*)b, sizeof(b));
+    os.write((const char*)pop[i].second.Weights(), 6 * sizeof(Wtype));
+  }
+}
+
+static bool ReadIndividuals(std::istream& is, Population* pop) {
+  for (size_t i = 0; i < pop->size(); ++i) {
+    int32_t b[2];
+    Wtype w[6];
+    if (!is.read((char*)b, sizeof(b)) || !is.read((char*)w, sizeof(w))) {
+      return false;
+    }
+    (*pop)[i].first = Badness(b[0], b[1]);
+    (*pop)[i].second.SetWeights(w);
+  }
+  return true;
+}
+
+// Saves the state after the given generation: the population, the nbest
+// and the state of the PRNG. The checkpoint is written to a temporary file
+// which then replaces the old one, so a checkpoint is never left half
+// written. The file and then its directory are synced before and after the
+// rename, so that a crash cannot leave the rename on disk without the data.
+static bool SyncPath(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  const bool ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+}
+
+static std::string DirName(const std::string& path) {
+  const size_t slash = path.rfind('/');
+  if (slash == std::string::npos) return ".";
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static bool SaveCheckpoint(const std::string& path, const uint64_t generation,
+                           const Population& population,
+                           const Population& nbest) {
+  CheckpointHeader h;
+  memcpy(h.magic, kCheckpointMagic, sizeof(h.magic));
+  h.generation = generation;
+  h.population = population.size();
+  h.nbest = nbest.size();
+  h.cols = FLAGS_cols;
+  h.rows = FLAGS_rows;
+  h.max_depth = FLAGS_max_depth;
+  h.random = FLAGS_random;
+  std::ostringstream prng;
+  prng << PRNG;
+  const uint32_t prng_size = prng.str().size();
+  const std::string tmp = path + ".tmp";
+  std::ofstream of(tmp.c_str(), std::ios::binary);
+  if (!of.is_open()) return false;
+  of.write((const char*)&h, sizeof(h));
+  WriteIndividuals(of, population);
+  WriteIndividuals(of, nbest);
+  of.write((const char*)&prng_size, sizeof(prng_size));
+  of.write(prng.str().data(), prng_size);
+  of.flush();
+  of.close();
+  if (!of || !SyncPath(tmp)) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return rename(tmp.c_str(), path.c_str()) == 0 && SyncPath(DirName(path));
+}
+
+// Restores the state saved by SaveCheckpoint and returns its generation.
+static uint64_t LoadCheckpoint(const std::string& path, Population* population,
+                               Population* nbest) {
+  std::ifstream is(path.c_str(), std::ios::binary);
+  CHECK(is.is_open()) << "File \"" << path << "\" could not been opened.";
+  CheckpointHeader h;
+  CHECK(is.read((char*)&h, sizeof(h)) &&
+        memcmp(h.magic, kCheckpointMagic, sizeof(h.magic)) == 0)
+      << "File \"" << path << "\" is not a checkpoint";
+  CHECK(h.population == FLAGS_population && h.nbest == FLAGS_nbest &&
+        h.cols == FLAGS_cols && h.rows == FLAGS_rows &&
+        h.max_depth == FLAGS_max_depth && h.random == FLAGS_random)
+      << "The checkpoint was saved with -population " << h.population
+      << " -nbest " << h.nbest << " -cols " << h.cols << " -rows " << h.rows
+      << " -max_depth " << h.max_depth << " -random " << h.random;
+  population->resize(h.population);
+  nbest->resize(h.nbest);
+  uint32_t prng_size = 0;
+  CHECK(ReadIndividuals(is, population) && ReadIndividuals(is, nbest) &&
+        is.read((char*)&prng_size, sizeof(prng_size)))
+      << "File \"" << path << "\" is truncated";
+  std::string prng(prng_size, ' ');
+  CHECK(is.read(&prng[0], prng_size)) << "File \"" << path
+                                      << "\" is truncated";
+  std::istringstream iss(prng);
+  CHECK(iss >> PRNG) << "Bad PRNG state in \"" << path << "\"";
+  return h.generation;
+}
+
 int main(int argc, char** argv) {
   // Google tools initialization
   google::InitGoogleLogging(argv[0]);
   google::SetUsageMessage(
       "Tool for selecting the best weights");
   google::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_worker) {
+    CHECK(!FLAGS_coordinator.empty()) << "-worker needs a -coordinator";
+    RunGameWorker(FLAGS_coordinator, FLAGS_nthreads, PlayGameJob);
+    return 0;
+  }
   // Random seed
   PRNG.seed(FLAGS_seed);
 
@@ -173,8 +370,35 @@ int main(int argc, char** argv) {
   for (size_t i = 0; i < FLAGS_nbest; ++i) {
     nbest[i].second = population[i].second;
   }
+  uint64_t first_generation = 1;
+  if (FLAGS_resume) {
+    CHECK(!FLAGS_checkpoint.empty()) << "-resume needs a -checkpoint";
+    first_generation =
+        LoadCheckpoint(FLAGS_checkpoint, &population, &nbest) + 1;
+    LOG(INFO) << "Resuming after generation " << first_generation - 1;
+  }
   const size_t half_pop = FLAGS_population / 2;
-  for (size_t g = 1; g <= FLAGS_generations; ++g) {
+  WorkStealingPool pool(FLAGS_nthreads);
+  std::unique_ptr<GameCoordinator> coordinator;
+  if (!FLAGS_listen.empty()) {
+    coordinator.reset(new GameCoordinator(FLAGS_listen, FLAGS_batch_size,
+                                          FLAGS_batch_timeout_s,
+                                          FLAGS_worker_wait_s));
+  }
+  // Without shuffling, a game only depends on the weights of its players,
+  // so the games against the nbest survivors need not be played again.
+  std::unique_ptr<GameCache> cache;
+  if (!FLAGS_random) {
+    cache.reset(new GameCache);
+    if (!FLAGS_game_cache.empty()) {
+      CHECK(cache->Open(FLAGS_game_cache, GameSettings()))
+          << "File \"" << FLAGS_game_cache << "\" could not been opened.";
+      LOG(INFO) << "Cached games = " << cache->Size();
+    }
+  } else if (!FLAGS_game_cache.empty()) {
+    LOG(WARNING) << "Games are not cached with -random true";
+  }
+  for (size_t g = first_generation; g <= FLAGS_generations; ++g) {
     // Perform crossover and mutations
     std::shuffle(population.begin(), population.end(), PRNG);
     for (size_t i = 0; i < half_pop; ++i) {
@@ -203,27 +427,64 @@ int main(int argc, char** argv) {
         })));
     // Perform evaluation of each individual (old and new)
     std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
-    std::vector<std::thread> threads(FLAGS_nthreads);
-    for (size_t t = 0; t < FLAGS_nthreads; ++t) {
-      threads[t] = std::thread(
-          [](std::vector<std::pair<Badness,Individual>>& population,
-             const std::vector<std::pair<Badness,Individual>>& nbest,
-             const size_t th) {
-               for (size_t i = th; i < population.size(); i += FLAGS_nthreads) {
-                 int w = 0; int r = 0;
-                 for (size_t j = 0; j < FLAGS_nbest; ++j) {
-                   int w0 = 0, w1 = 0, r0 = 0, r1 = 0;
-                   PlayGame(population[i].second.Weights(), nbest[j].second.Weights(), FLAGS_cols, FLAGS_rows, &w0, &r0);
-                   PlayGame(nbest[j].second.Weights(), population[i].second.Weights(), FLAGS_cols, FLAGS_rows, &w1, &r1);
-                   w += w0 - w1;
-                   r += r0 + r1;
-                 }
-                 population[i].first = Badness(w, w < 0 ? r : -r);
-               }
-             }, std::ref(population), std::cref(nbest), t);
-    }
-    for (size_t t = 0; t < FLAGS_nthreads; ++t) {
-      threads[t].join();
+    // Each task is a game between an individual and one of the nbest, with
+    // the individual playing first (even tasks) or second (odd tasks).
+    const size_t games_per_ind = 2 * FLAGS_nbest;
+    const size_t num_tasks = population.size() * games_per_ind;
+    std::vector<uint64_t> seeds(num_tasks);
+    for (size_t k = 0; k < num_tasks; ++k) { seeds[k] = PRNG(); }
+    std::vector<int> winners(num_tasks), rounds(num_tasks);
+    // Games not in the cache, with the task they come from as id.
+    std::vector<GameJob> jobs;
+    for (size_t k = 0; k < num_tasks; ++k) {
+      const Wtype* wi = population[k / games_per_ind].second.Weights();
+      const Wtype* wj = nbest[(k % games_per_ind) / 2].second.Weights();
+      const Wtype* wa = k % 2 == 0 ? wi : wj;
+      const Wtype* wb = k % 2 == 0 ? wj : wi;
+      GameJob job;
+      job.id = k;
+      std::copy(wa, wa + 6, job.wa);
+      std::copy(wb, wb + 6, job.wb);
+      job.cols = FLAGS_cols;
+      job.rows = FLAGS_rows;
+      job.depth = FLAGS_max_depth;
+      job.random = FLAGS_random;
+      job.seed = seeds[k];
+      if (cache && cache->Find(CacheKey(job), &winners[k], &rounds[k])) {
+        continue;
+      }
+      jobs.push_back(job);
+    }
+    std::vector<GameJobResult> results(jobs.size());
+    if (coordinator) {
+      CHECK(coordinator->Run(jobs, &results))
+          << "No workers to play the games";
+    } else {
+      pool.Run(jobs.size(), [&](const size_t i) {
+          PlayGameJob(jobs[i], &results[i]);
+        });
+    }
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      const size_t k = jobs[i].id;
+      winners[k] = results[i].winner;
+      rounds[k] = results[i].rounds;
+      if (cache) { cache->Insert(CacheKey(jobs[i]), winners[k], rounds[k]); }
+    }
+    if (cache) {
+      LOG(INFO) << "Generation " << g << ": Cached games = "
+                << num_tasks - jobs.size() << " / " << num_tasks;
+      if (!FLAGS_game_cache.empty() && !cache->Flush()) {
+        LOG(WARNING) << "Games could not be saved to \""
+                     << FLAGS_game_cache << "\"";
+      }
+    }
+    for (size_t i = 0; i < population.size(); ++i) {
+      int w = 0; int r = 0;
+      for (size_t k = i * games_per_ind; k < (i + 1) * games_per_ind; ++k) {
+        w += k % 2 == 0 ? winners[k] : -winners[k];
+        r += rounds[k];
+      }
+      population[i].first = Badness(w, w < 0 ? r : -r);
     }
     std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
     // Sort individuals in order of increasing badness
@@ -234,6 +495,12 @@ int main(int argc, char** argv) {
     }
     std::chrono::duration<float> ts = t2 - t1;
     std::cout << "Generation " << g << " = " << nbest[0].second << " " << nbest[0].first << " (Time = " << ts.count() << ")" << std::endl;
+    if (!FLAGS_checkpoint.empty() &&
+        (g % std::max<uint64_t>(FLAGS_checkpoint_every, 1) == 0 ||
+         g == FLAGS_generations)) {
+      CHECK(SaveCheckpoint(FLAGS_checkpoint, g, population, nbest))
+          << "File \"" << FLAGS_checkpoint << "\" could not been written.";
+    }
   }
   return 0;
 }